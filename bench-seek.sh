@@ -0,0 +1,102 @@
+# archeolog: benchmark: start-date search latency on uncached file data
+# Run in the build directory: make bench-seek
+# The file is evicted from the page cache before each query,
+#  so the results depend on the storage where the file is located.
+# Environment:
+#  BENCH_FILE     log file (=bench.log): generated if it doesn't exist
+#  BENCH_SIZE     generated file size (=2g)
+#  BENCH_OUT      results (=bench-seek.json)
+#  BENCH_QUERIES  N of random queries for each setting (=50)
+#  BENCH_PROBES   search block sizes (=4096 16384 65536)
+#  BENCH_ALIGNS   read offset alignments (=4096)
+#  BENCH_SEED     random seed for the query dates (=1)
+
+set -e
+
+BIN=./archeolog
+GEN=./gen-log
+FILE=${BENCH_FILE:-bench.log}
+SIZE=${BENCH_SIZE:-2g}
+OUT=${BENCH_OUT:-bench-seek.json}
+QUERIES=${BENCH_QUERIES:-50}
+PROBES=${BENCH_PROBES:-4096 16384 65536}
+ALIGNS=${BENCH_ALIGNS:-4096}
+SEED=${BENCH_SEED:-1}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+if ! test -f "$FILE" ; then
+	$GEN --size=$SIZE --line=64-1024 --dist=exp --gaps=1 --gap=60 --disorder=5 "$FILE"
+fi
+
+# The same random dates within the file's time range for each setting
+T0=$(date -u -d '2022-06-26 00:00:00' +%s)
+T1=$(date -u -d "$(tail -c 4096 "$FILE" | tail -n 1 | cut -c1-19)" +%s)
+awk -v n=$QUERIES -v seed=$SEED -v t0=$T0 -v t1=$T1 'BEGIN {
+	srand(seed)
+	for (i = 0;  i != n;  i++)
+		print int(t0 + (t1 - t0) * rand())
+}' | while read -r t ; do
+	date -u -d "@$t" '+%Y-%m-%d %H:%M:%S'
+done > "$TMP/dates"
+
+now_ns() {
+	date +%s%N
+}
+
+# Print the value of KEY from JSON object
+json_val() {
+	sed -n "s/.*\"$1\":\([0-9]*\).*/\1/p"
+}
+
+# Print JSON object with the distribution of the numbers in FILE
+dist() {
+	sort -n "$1" | awk '
+{ v[NR] = $1;  sum += $1 }
+END {
+	if (NR == 0) { printf "{}";  exit }
+	printf "{\"min\":%u, \"p50\":%u, \"p90\":%u, \"p99\":%u, \"max\":%u, \"avg\":%u}", \
+		v[1], v[int((NR - 1) * 0.5) + 1], v[int((NR - 1) * 0.9) + 1], v[int((NR - 1) * 0.99) + 1], v[NR], sum / NR
+}'
+}
+
+# Execute the queries with the specified settings and print JSON object
+# $1: probe size;  $2: alignment
+run() {
+	: > "$TMP/time" ; : > "$TMP/search" ; : > "$TMP/reads" ; : > "$TMP/iops"
+	while read -r d ; do
+		$GEN --evict "$FILE"
+		local t=$(now_ns)
+		$BIN -s "$d" -e "$d" --probe=$1 --align=$2 --stats=json "$FILE" 2>"$TMP/stats" >/dev/null
+		t=$(( ($(now_ns) - t) / 1000 ))
+		local st=$(grep '^{' "$TMP/stats")
+		local search=$(echo "$st" | json_val search_usec)
+		local reads=$(echo "$st" | json_val search_reads)
+		echo $t >> "$TMP/time"
+		echo $search >> "$TMP/search"
+		echo $reads >> "$TMP/reads"
+		# reads per second during the search
+		echo $(( reads * 1000000 / (search + 1) )) >> "$TMP/iops"
+	done < "$TMP/dates"
+
+	printf '{"probe":%u, "align":%u, "time_us":%s, "search_us":%s, "search_reads":%s, "iops":%s}' \
+		$1 $2 "$(dist "$TMP/time")" "$(dist "$TMP/search")" "$(dist "$TMP/reads")" "$(dist "$TMP/iops")"
+}
+
+{
+	printf '{"version":"%s", "file":"%s", "size":%u, "date":"%s", "queries":%u,\n"results":[\n' \
+		"$($BIN --help | head -n 1)" "$FILE" "$(wc -c < "$FILE")" "$(date -u '+%Y-%m-%dT%H:%M:%SZ')" $QUERIES
+	first=1
+	for align in $ALIGNS ; do
+		for probe in $PROBES ; do
+			if test $align -gt $probe ; then
+				continue
+			fi
+			test $first = 1 || printf ',\n'
+			first=0
+			run $probe $align
+		done
+	done
+	printf '\n]}\n'
+} > "$OUT"
+cat "$OUT"
@@ -0,0 +1,108 @@
+# archeolog: benchmark: start-date search and data extraction on a large generated log file
+# Run in the build directory: make bench
+# Environment:
+#  BENCH_FILE  log file (=bench.log): generated if it doesn't exist
+#  BENCH_SIZE  generated file size (=2g)
+#  BENCH_OUT   results (=bench.json)
+#  BENCH_COLD  0: don't run cold-cache tests (=1)
+
+set -e
+
+BIN=./archeolog
+GEN=./gen-log
+FILE=${BENCH_FILE:-bench.log}
+SIZE=${BENCH_SIZE:-2g}
+OUT=${BENCH_OUT:-bench.json}
+COLD=${BENCH_COLD:-1}
+
+if ! test -f "$FILE" ; then
+	$GEN --size=$SIZE --line=64-1024 --dist=exp --gaps=1 --gap=60 --disorder=5 "$FILE"
+fi
+
+# Date at N% of the file's time range
+T0=$(date -u -d '2022-06-26 00:00:00' +%s)
+T1=$(date -u -d "$(tail -c 4096 "$FILE" | tail -n 1 | cut -c1-19)" +%s)
+at() {
+	date -u -d "@$(( T0 + (T1 - T0) * $1 / 100 ))" '+%Y-%m-%d %H:%M:%S'
+}
+
+# name|arguments
+CASES="seek-10|-s '$(at 10)' -e '$(at 10)'
+seek-50|-s '$(at 50)' -e '$(at 50)'
+seek-90|-s '$(at 90)' -e '$(at 90)'
+extract-10%|-s '$(at 40)' -e '$(at 50)'
+filter-10%|-s '$(at 40)' -e '$(at 50)' -f 'tempor lorem ipsum dolor sit amet consectetur'
+fields-10%|-s '$(at 40)' -e '$(at 50)' --fields=1-3
+sample-1%|-s '$(at 0)' -e '$(at 100)' --sample=1%
+histogram|-s '$(at 0)' -e '$(at 100)' --histogram=1h"
+
+now_ns() {
+	date +%s%N
+}
+
+# KB read from disk by all processes
+pgpgin() {
+	awk '/^pgpgin /{print $2}' /proc/vmstat 2>/dev/null || echo 0
+}
+
+# Execute the test case and print JSON object
+# $1: name;  $2: arguments;  $3: hot|cold
+run() {
+	if test "$3" = "cold" ; then
+		$GEN --evict "$FILE"
+	else
+		eval "$BIN $2 '$FILE'" >/dev/null 2>&1 || true
+	fi
+
+	local pg=$(pgpgin)
+	local t=$(now_ns)
+	eval "$BIN $2 '$FILE'" >/dev/null 2>&1
+	t=$(( ($(now_ns) - t) / 1000 ))
+	local disk_kb=$(( $(pgpgin) - pg ))
+
+	# the counters from debug log: they don't depend on page cache state
+	eval "$BIN -D $2 '$FILE'" 2>&1 >/dev/null | awk -v name="$1" -v cache="$3" -v us=$t -v disk_kb=$disk_kb '
+/^DBG:\tfound start-time line/ {
+	for (i = 1;  i <= NF;  i++) {
+		if ($(i+1) == "jumps") jumps += $i
+		if ($i ~ /us,$/) { v = $i;  sub(/us,/, "", v);  search_us += v }
+	}
+}
+/^DBG:\t(file read|reader): [0-9]+ @/ {
+	v = $0;  sub(/^DBG:\t[a-z ]+: /, "", v);  sub(/ .*/, "", v)
+	read_bytes += v;  reads++
+}
+/^DBG:\tfile: cache-hits:/ {
+	v = $3;  sub(/.*:/, "", v);  hits += v
+	v = $4;  sub(/.*:/, "", v);  misses += v
+}
+/^DBG:\toutput:/ {
+	v = $2;  sub(/.*:/, "", v);  out += v
+}
+END {
+	mbps = (us != 0) ? out / us : 0
+	printf "{\"name\":\"%s\", \"cache\":\"%s\", \"time_us\":%u, \"search_us\":%u, \"jumps\":%u", \
+		name, cache, us, search_us, jumps
+	printf ", \"reads\":%u, \"read_bytes\":%u, \"disk_read_bytes\":%u, \"fcache_hits\":%u, \"fcache_misses\":%u", \
+		reads, read_bytes, disk_kb * 1024, hits, misses
+	printf ", \"output_bytes\":%u, \"output_mbps\":%.1f}", out, mbps
+}'
+}
+
+{
+	printf '{"version":"%s", "file":"%s", "size":%u, "date":"%s",\n"results":[\n' \
+		"$($BIN --help | head -n 1)" "$FILE" "$(wc -c < "$FILE")" "$(date -u '+%Y-%m-%dT%H:%M:%SZ')"
+	first=1
+	echo "$CASES" | while IFS='|' read -r name args ; do
+		for cache in hot cold ; do
+			if test "$cache" = "cold" && test "$COLD" = "0" ; then
+				continue
+			fi
+			test $first = 1 || printf ',\n'
+			first=0
+			run "$name" "$args" $cache
+		done
+	done
+	printf '\n]}\n'
+} > "$OUT"
+cat "$OUT"
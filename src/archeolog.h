@@ -2,11 +2,20 @@
 2022, Simon Zolin */
 
 #include <FFOS/process.h>
+#include <FFOS/file.h>
 #include <FFOS/error.h>
 #include <FFOS/time.h>
 
 #define ARLG_VER  "0.2"
 
+/** The public interface of the library and the functions for plugins:
+ the other symbols are hidden (-fvisibility=hidden) */
+#ifdef FF_WIN
+	#define ARLG_EXPORT  __declspec(dllexport)
+#else
+	#define ARLG_EXPORT  __attribute__((visibility("default")))
+#endif
+
 typedef unsigned short ushort;
 typedef unsigned int uint;
 typedef long long int64;
@@ -14,23 +23,189 @@ typedef unsigned long long uint64;
 
 struct arlg_conf {
 	char *filename;
+	ffvec inputs; // char*[]: the input files after the first one: merge the lines by timestamp
 	ffstr filter;
+	ffbyte filter_word; // the filter text must be bounded by non-word characters
+	ffbyte index; // use the content index of the file (FILE.arlgidx)
 	fftime start_date, end_date;
+	ffbyte dates_rel; // enum ARLG_DATES_REL: the dates are set after the newest timestamp in file is found
+	uint start_ago, end_ago; // relative dates: N of seconds before the newest timestamp
+	fftime newest; // relative dates: the newest timestamp among several input files (set by arlg_merge())
+	ffbyte dates_noyear, dates_nodate; // enum ARLG_DATES_REL: the dates without year (syslog) or date (time only):
+		// completed from the first timestamp in file
 	uint read_chunk_size_small, read_chunk_size_large;
 	uint read_chunk_align;
-	uint date_fmt;
-	uint date_len;
+	ffbyte probe_fixed; // the user has set read_chunk_size_small: don't tune it by read latency
+	uint ts_fmt; // enum TS_FMT
+	uint ts_field; // timestamp is in N-th space-separated field (from 1)
+	uint ts_offset; // timestamp offset in bytes (from the line or field start)
+	ffstr ts_key; // JSON lines: timestamp is the value of this key
+	uint ts_year; // year for the formats that don't have it
+	uint ts_frac; // user-specified dates have fractions of a second
+	uint date_fmt; // TSF_ISO: FFTIME_DATE_*, FFTIME_HMS*
+	uint date_len; // max N of bytes (from the line start) needed to parse timestamp
+	struct {
+		char tmpl[32]; // layout of a sortable timestamp: '0' - digit, ' ' - date-time split
+		char start[32], end[32]; // start/end dates as the user specified them
+		uint start_len, end_len;
+		uint len; // 0: layout isn't sortable
+		uint split;
+		uint64 digit_mask[4], lit_mask[4];
+	} lex;
 	uint64 max_lines;
+	ffbyte records; // a line without timestamp belongs to the previous line
+	uint hist_interval; // histogram bucket size (seconds)
+	ffbyte hist_exact; // count the lines in histogram buckets
+	uint sample, sample_per; // read 'sample' blocks of every 'sample_per' blocks
+	ffbyte explain; // output the query cost estimate instead of the lines
+	ffbyte explain_interp; // explain: estimate the range offsets by interpolation
+	ffvec proj; // struct arlg_range[]: fields or columns to output (sorted)
+	ffbyte proj_columns; // 'proj' contains columns
+	char delim; // field delimiter
+	ffstr chain; // comma-separated filter names
+	ffvec plugins; // char*[]: shared objects with filters
+	ffbyte threads; // read, process and write data in parallel
+	char *serve; // Unix socket path: process the queries from clients
+	ffvec serve_allow; // char*[]: the server opens only the files within these directories
+	uint serve_mode; // access mode of the socket file
+	ffbyte suspend; // arlg_extract() returns after each output
+	ffbyte merged; // the input of arlg_merge(): there may be no lines at or after start-date
+	ffbyte stats; // enum ARLG_STATS: print execution statistics
+	char *trace; // write timeline trace to this file
+	ffbyte hugepages; // back the read buffers by 2MB pages
 	ffbyte debug;
+
+	/** Log message (default: stderr)
+	level: enum ARLG_LOG */
+	void (*log)(void *udata, uint level, const char *msg, ffsize len);
+	/** Output data (default: stdout)
+	Return 0 on success */
+	int (*output)(void *udata, const char *data, ffsize len);
+	void *udata; // opaque user data for the callbacks
+
+	const struct arlg_shared_if *shared_if; // optional
+	void *shared;
+};
+
+/** Warm state shared between processor instances (server) */
+struct arlg_shared_if {
+	/** Get the file descriptor
+	Return FFFILE_NULL on error */
+	fffd (*file_open)(void *shared, const char *name);
+	void (*file_close)(void *shared, fffd fd);
+
+	/** Copy the data block at offset 'off' from cache
+	Return N of bytes copied;  0: not in cache */
+	ffsize (*block_get)(void *shared, fffd fd, uint64 off, char *buf, ffsize len);
+	void (*block_put)(void *shared, fffd fd, uint64 off, const char *data, ffsize len);
 };
-extern struct arlg_conf *gconf;
 
-void conf_destroy(struct arlg_conf *conf);
+enum ARLG_LOG {
+	ARLG_LOG_ERR,
+	ARLG_LOG_INFO,
+	ARLG_LOG_DBG,
+	ARLG_LOG_STATS, // execution statistics after the processing
+};
+
+enum ARLG_DATES_REL {
+	ARLG_REL_START = 1,
+	ARLG_REL_END = 2,
+};
+
+enum ARLG_STATS {
+	ARLG_STATS_JSON = 1,
+};
+
+/** Range of fields or columns (from 1) */
+struct arlg_range {
+	uint lo, hi;
+};
+
+enum TS_FMT {
+	TSF_NONE,
+	TSF_ISO, // [yyyy-MM-dd[ T]][hh:mm:ss[.msc]]
+	TSF_RFC3339, // yyyy-MM-ddThh:mm:ss[.frac][Z|+hh:mm]
+	TSF_SYSLOG, // Mmm dd hh:mm:ss
+	TSF_NGINX, // [dd/Mmm/yyyy:hh:mm:ss +zzzz]
+	TSF_EPOCH, // UNIX time: 1656230400[.frac]
+	TSF_EPOCH_MS, // UNIX time in milliseconds: 1656230400123
+};
+
+/** Max N of bytes before the timestamp field */
+#define TS_FIELD_MAXOFF  128
+
+/** Max N of bytes before the timestamp value in JSON lines */
+#define TS_JSON_MAXOFF  1024
+
+ARLG_EXPORT void conf_destroy(struct arlg_conf *conf);
 int date_parse(struct arlg_conf *conf, const ffstr *s, fftime *t);
-int conf_cmdline(struct arlg_conf *conf, int argc, const char **argv);
+int date_parse_exact(struct arlg_conf *conf, const ffstr *s, fftime *t);
+void ts_detect(struct arlg_conf *conf, const char *data, ffsize len);
+void ts_lead(struct arlg_conf *conf, ffbyte *lo, ffbyte *hi);
+int conf_dates_resolve(struct arlg_conf *conf, const fftime *newest);
+int conf_dates_complete(struct arlg_conf *conf, const char *data, ffsize len);
 
+/** The result of the last date comparison */
+struct date_cache {
+	char prefix[32];
+	uint len;
+	int r, cmp;
+};
+
+enum DATE_BOUND {
+	DATE_START,
+	DATE_END,
+};
+
+int date_cmp(struct arlg_conf *conf, const ffstr *s, uint bound, struct date_cache *dc, int *cmp);
+/** Set configuration from command line.
+The callbacks (log, output, udata) may be set before.
+argv[0] is skipped. */
+ARLG_EXPORT int conf_cmdline(struct arlg_conf *conf, int argc, const char **argv);
+
+
+/* Library interface.
+Each processor instance uses only its own configuration object.
+The instances may run in parallel threads. */
 
 struct archeolog;
+
+/** Create processor
+conf: must stay valid until arlg_free();
+ 'start_date' and 'lex' fields are modified during processing (histogram, sampling)
+Return NULL on error */
+ARLG_EXPORT struct archeolog* arlg_create(struct arlg_conf *conf);
+
+ARLG_EXPORT void arlg_free(struct archeolog *a);
+
+enum ARLG_R {
+	ARLG_R_OK,
+	ARLG_R_ERR,
+	ARLG_R_CANCEL,
+	ARLG_R_SUSPEND, // conf->suspend: the output function has been called; call arlg_extract() again to continue
+};
+
+/** Process the data and pass it to the output
+Return enum ARLG_R */
+ARLG_EXPORT int arlg_extract(struct archeolog *a);
+
+/** Stop the processing as soon as possible.  Thread-safe. */
+ARLG_EXPORT void arlg_cancel(struct archeolog *a);
+
+/** Merge the lines from 'conf->filename' and 'conf->inputs' in timestamp order.
+A line without timestamp stays with the previous line from the same file.
+Return 0 on success */
+ARLG_EXPORT int arlg_merge(struct arlg_conf *conf);
+
+/** Find the newest timestamp in file 'conf->filename'
+Return 0 on success */
+int arlg_file_newest(struct arlg_conf *conf, fftime *t);
+
+/** Process the queries from the clients connected to Unix socket 'conf->serve'
+Return 0 on success */
+int serve(struct arlg_conf *conf);
+
+
 struct filter_if {
 	const char *name;
 	/** Return enum CHAIN_R */
@@ -54,6 +229,17 @@ enum CHAIN_FLAGS {
 	CHAIN_FFIRST = 2, // filter is first in chain
 };
 
+/** Plugin (shared object) exports a NULL-terminated array of its filters:
+ARLG_EXPORT const struct filter_if *arlg_plugin_filters[] = { &filter_x, NULL }; */
+#define ARLG_PLUGIN_FILTERS  "arlg_plugin_filters"
+
+/** The first fields of struct archeolog: available to plugin filters */
+struct arlg_pub {
+	struct arlg_conf *conf;
+	uint chain_flags; // enum CHAIN_FLAGS
+	void **fctx; // the current filter's data pointer (per instance)
+};
+
 
 enum FBEH_E {
 	FBEH_SEQ = 1,
@@ -62,18 +248,26 @@ enum FBEH_E {
 
 /**
 flags: enum FBEH_E */
-int arlg_file_behaviour(struct archeolog *a, uint flags);
+ARLG_EXPORT int arlg_file_behaviour(struct archeolog *a, uint flags);
 
-void arlg_file_seek(struct archeolog *a, uint64 off);
+ARLG_EXPORT void arlg_file_seek(struct archeolog *a, uint64 off);
 
+/** Set the block size for random access (until the next arlg_file_behaviour()) */
+ARLG_EXPORT void arlg_file_probe(struct archeolog *a, uint size);
 
-void log_print(int level, const char *fmt, ...);
 
-#define dbglog(fmt, ...) \
+/**
+level: enum ARLG_LOG */
+ARLG_EXPORT void arlg_log(struct arlg_conf *conf, uint level, const char *fmt, ...);
+
+#define dbglog(conf, fmt, ...) \
 do { \
-	if (gconf->debug) \
-		log_print(1, "DBG:\t" fmt "\n", ##__VA_ARGS__); \
+	if ((conf)->debug) \
+		arlg_log(conf, ARLG_LOG_DBG, fmt, ##__VA_ARGS__); \
 } while (0);
 
-#define errlog(fmt, ...) \
-	log_print(0, "ERR:\t" fmt "\n", ##__VA_ARGS__)
+#define errlog(conf, fmt, ...) \
+	arlg_log(conf, ARLG_LOG_ERR, fmt, ##__VA_ARGS__)
+
+#define infolog(conf, fmt, ...) \
+	arlg_log(conf, ARLG_LOG_INFO, fmt, ##__VA_ARGS__)
@@ -0,0 +1,115 @@
+/** archeolog: micro-benchmark: data copying in ffstream_gather_ref()
+2022, Simon Zolin */
+
+/*
+The input data is processed the same way as dataproc_process() does:
+ for each line we need 'gather' bytes from its start, then we search for its end.
+*/
+
+#include <util/stream.h>
+#include <FFOS/std.h>
+#include <FFOS/time.h>
+
+#define DATA_SIZE  (256*1024*1024)
+
+/** Fill buffer with lines of random length */
+static ffsize gen(char *d, ffsize cap, ffuint line_min, ffuint line_max, ffuint64 *nlines)
+{
+	static const char ts[] = "2022-06-26 00:00:00.000 ";
+	ffuint seed = 1;
+	ffsize n = 0;
+	*nlines = 0;
+	for (;;) {
+		seed = seed * 1103515245 + 12345;
+		ffuint len = line_min + (seed >> 8) % (line_max - line_min + 1);
+		if (n + len > cap)
+			break;
+		ffmem_copy(d + n, ts, ffmin(len - 1, FFS_LEN(ts)));
+		if (len - 1 > FFS_LEN(ts))
+			ffmem_fill(d + n + FFS_LEN(ts), 'x', len - 1 - FFS_LEN(ts));
+		d[n + len - 1] = '\n';
+		n += len;
+		(*nlines)++;
+	}
+	return n;
+}
+
+/** Return N of lines */
+static ffuint64 run(ffstream *s, const char *data, ffsize size, ffuint block, ffuint gather)
+{
+	enum { I_CHECK, I_FINDLINE };
+	ffuint state = I_CHECK;
+	ffuint64 lines = 0;
+	ffstr in, buf, view;
+	ffssize r;
+
+	for (ffsize off = 0;  off < size;  off += block) {
+		ffstr_set(&in, data + off, ffmin(block, size - off));
+		ffuint last = (off + block >= size);
+
+		for (;;) {
+			r = ffstream_gather_ref(s, in, gather, &buf);
+			ffstr_shift(&in, r);
+			if (buf.len < gather) {
+				if (s->ref.len != 0)
+					continue; // store input data in buffer
+				if (in.len == 0 && !last)
+					break; // need next block
+			}
+
+			view = buf;
+			for (;;) {
+				if (state == I_CHECK) {
+					if (view.len == 0 || (view.len < gather && !(last && in.len == 0)))
+						break;
+					lines++;
+					state = I_FINDLINE;
+				}
+				if (0 > (r = ffs_findchar(view.ptr, view.len, '\n'))) {
+					ffstr_shift(&view, view.len);
+					break;
+				}
+				ffstr_shift(&view, r + 1);
+				state = I_CHECK;
+			}
+			ffstream_consume(s, view.ptr - buf.ptr);
+			if (last && in.len == 0 && ffstream_used(s) == 0)
+				break;
+		}
+	}
+	return lines;
+}
+
+int main(int argc, char **argv)
+{
+	static const ffuint blocks[] = { 4*1024, 1024*1024 };
+	static const ffuint gathers[] = { 32, 1024 };
+	static const ffuint line_lens[][2] = { {40, 200}, {200, 2000} };
+	char *data = ffmem_alloc(DATA_SIZE);
+	ffuint64 nlines;
+
+	for (ffuint il = 0;  il != FF_COUNT(line_lens);  il++) {
+		ffsize size = gen(data, DATA_SIZE, line_lens[il][0], line_lens[il][1], &nlines);
+
+		for (ffuint ib = 0;  ib != FF_COUNT(blocks);  ib++) {
+			for (ffuint ig = 0;  ig != FF_COUNT(gathers);  ig++) {
+				ffstream s = {};
+				ffstream_realloc(&s, gathers[ig]);
+
+				fftime t1 = fftime_monotonic();
+				ffuint64 lines = run(&s, data, size, blocks[ib], gathers[ig]);
+				fftime t2 = fftime_monotonic();
+				fftime_sub(&t2, &t1);
+
+				ffstdout_fmt("line:%u-%u  block:%u  gather:%u  lines:%U%s  copied:%U bytes/GB  %Ums\n"
+					, line_lens[il][0], line_lens[il][1], blocks[ib], gathers[ig]
+					, lines, (lines != nlines) ? "(ERROR)" : ""
+					, s.copied * 1024*1024*1024 / size, fftime_to_msec(&t2));
+				ffstream_free(&s);
+			}
+		}
+	}
+
+	ffmem_free(data);
+	return 0;
+}
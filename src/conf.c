@@ -3,14 +3,32 @@
 
 #include <archeolog.h>
 #include <util/cmdarg-scheme.h>
+#include <util/simd.h>
 #include <FFOS/std.h>
 
-struct arlg_conf *gconf;
 
 void conf_destroy(struct arlg_conf *conf)
 {
 	ffmem_free(conf->filename);
+	ffmem_free(conf->serve);
+	ffmem_free(conf->trace);
 	ffstr_free(&conf->filter);
+	ffstr_free(&conf->ts_key);
+	ffvec_free(&conf->proj);
+	ffstr_free(&conf->chain);
+	char **it;
+	FFSLICE_WALK(&conf->plugins, it) {
+		ffmem_free(*it);
+	}
+	ffvec_free(&conf->plugins);
+	FFSLICE_WALK(&conf->serve_allow, it) {
+		ffmem_free(*it);
+	}
+	ffvec_free(&conf->serve_allow);
+	FFSLICE_WALK(&conf->inputs, it) {
+		ffmem_free(*it);
+	}
+	ffvec_free(&conf->inputs);
 }
 
 int conf_date(struct arlg_conf *conf, ffdatetime *dt, ffstr *s)
@@ -22,10 +40,8 @@ int conf_date(struct arlg_conf *conf, ffdatetime *dt, ffstr *s)
 		FFS_LEN("yyyy-MM-dd"),
 	};
 	for (uint i = 0;  ;  i++) {
-		if (i == FF_COUNT(date_fmts)) {
-			dbglog("unsupported date format: %S", s);
+		if (i == FF_COUNT(date_fmts))
 			return 0;
-		}
 
 		if (0 == _fftime_date_fromstr(dt, s, date_fmts[i])) {
 			conf->date_fmt = date_fmts[i];
@@ -36,8 +52,7 @@ int conf_date(struct arlg_conf *conf, ffdatetime *dt, ffstr *s)
 					ffstr_shift(s, 1);
 					conf->date_len++;
 				} else {
-					errlog("unsupported date-time split character: '%c'", s->ptr[0]);
-					return 1;
+					return 1; // unsupported date-time split character
 				}
 			}
 			break;
@@ -55,10 +70,8 @@ int conf_time(struct arlg_conf *conf, ffdatetime *dt, ffstr *s)
 		FFS_LEN("hh:mm:ss.msc"), FFS_LEN("hh:mm:ss")
 	};
 	for (uint i = 0;  ;  i++) {
-		if (i == FF_COUNT(time_fmts)) {
-			errlog("unsupported time format: %S", s);
+		if (i == FF_COUNT(time_fmts))
 			return 1;
-		}
 
 		if (0 == _fftime_time_fromstr(dt, s, time_fmts[i])) {
 			conf->date_fmt |= time_fmts[i];
@@ -69,34 +82,376 @@ int conf_time(struct arlg_conf *conf, ffdatetime *dt, ffstr *s)
 	return 0;
 }
 
-/**
-Return >0: success
- <0: need more data
- 0: error */
-int date_parse(struct arlg_conf *conf, const ffstr *s, fftime *t)
+/** Detect "yyyy-MM-dd", "hh:mm:ss[.msc]" or their combination */
+static int conf_iso(struct arlg_conf *conf, ffstr s)
 {
-	ffstr ss = *s;
 	ffdatetime dt = {};
+	conf->date_fmt = 0;
+	conf->date_len = 0;
+	if (0 != conf_date(conf, &dt, &s))
+		return 1;
+	if (s.len != 0 || conf->date_fmt == 0) {
+		if (0 != conf_time(conf, &dt, &s))
+			return 1;
+	}
+	return 0;
+}
+
+static const char month_names[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+/** Parse exactly `ndig` digits */
+static int ts_int(const char *p, uint ndig, uint *val)
+{
+	uint v = 0;
+	for (uint i = 0;  i < ndig;  i++) {
+		uint d = (ffbyte)p[i] - '0';
+		if (d > 9)
+			return 0;
+		v = v * 10 + d;
+	}
+	*val = v;
+	return ndig;
+}
+
+/** Parse month name: "Jan".."Dec" */
+static int ts_month(const char *p, uint *month)
+{
+	for (uint i = 0;  i < 12;  i++) {
+		if (!ffmem_cmp(p, &month_names[i * 3], 3)) {
+			*month = i + 1;
+			return 3;
+		}
+	}
+	return 0;
+}
+
+/** Parse fraction of a second: ".1" .. ".123456789"
+Return N of bytes processed */
+static uint ts_frac(const char *p, ffsize n, uint *nsec)
+{
+	if (n < 2 || p[0] != '.')
+		return 0;
+	uint i, v = 0;
+	for (i = 1;  i < ffmin(n, 10);  i++) {
+		uint d = (ffbyte)p[i] - '0';
+		if (d > 9)
+			break;
+		v = v * 10 + d;
+	}
+	if (i == 1)
+		return 0;
+	for (uint k = i;  k < 10;  k++) {
+		v *= 10;
+	}
+	*nsec = v;
+	return i;
+}
+
+/** Skip time zone: "Z" or "+hh:mm" or "+hhmm" */
+static uint ts_zone(const char *p, ffsize n)
+{
+	uint v;
+	if (n >= 1 && (p[0] == 'Z' || p[0] == 'z'))
+		return 1;
+	if (n >= 5 && (p[0] == '+' || p[0] == '-') && ts_int(p + 1, 2, &v)) {
+		if (n >= 6 && p[3] == ':' && ts_int(p + 4, 2, &v))
+			return 6;
+		if (ts_int(p + 3, 2, &v))
+			return 5;
+	}
+	return 0;
+}
+
+/** "hh:mm:ss" */
+static int ts_hms(const char *p, ffdatetime *dt)
+{
+	if (!(ts_int(p, 2, &dt->hour) && p[2] == ':'
+		&& ts_int(p + 3, 2, &dt->minute) && p[5] == ':'
+		&& ts_int(p + 6, 2, &dt->second)))
+		return 0;
+	if (dt->hour > 23 || dt->minute > 59 || dt->second > 60)
+		return 0;
+	return 8;
+}
+
+/** yyyy-MM-dd[T ]hh:mm:ss[.frac][Z|+hh:mm] */
+static int ts_rfc3339(const char *p, ffsize n, ffdatetime *dt)
+{
+	uint year;
+	if (n < FFS_LEN("yyyy-MM-ddThh:mm:ss"))
+		return 0;
+	if (!(ts_int(p, 4, &year) && p[4] == '-'
+		&& ts_int(p + 5, 2, &dt->month) && p[7] == '-'
+		&& ts_int(p + 8, 2, &dt->day)
+		&& (p[10] == 'T' || p[10] == 't' || p[10] == ' ')
+		&& ts_hms(p + 11, dt)))
+		return 0;
+	if (dt->month - 1 > 11 || dt->day - 1 > 30)
+		return 0;
+	dt->year = year;
+	uint i = 19;
+	i += ts_frac(p + i, n - i, &dt->nanosecond);
+	i += ts_zone(p + i, n - i);
+	return i;
+}
+
+/** Mmm dd hh:mm:ss
+Day may be padded with space */
+static int ts_syslog(struct arlg_conf *conf, const char *p, ffsize n, ffdatetime *dt)
+{
+	if (n < FFS_LEN("Mmm dd hh:mm:ss"))
+		return 0;
+	if (!(ts_month(p, &dt->month) && p[3] == ' '))
+		return 0;
+	if (p[4] == ' ') {
+		if (!ts_int(p + 5, 1, &dt->day))
+			return 0;
+	} else if (!ts_int(p + 4, 2, &dt->day)) {
+		return 0;
+	}
+	if (!(dt->day != 0 && p[6] == ' ' && ts_hms(p + 7, dt)))
+		return 0;
+	dt->year = (conf->ts_year != 0) ? conf->ts_year : 1970;
+	return 15;
+}
+
+/** [dd/Mmm/yyyy:hh:mm:ss +zzzz] */
+static int ts_nginx(const char *p, ffsize n, ffdatetime *dt)
+{
+	uint year;
+	if (n < FFS_LEN("[dd/Mmm/yyyy:hh:mm:ss +zzzz]"))
+		return 0;
+	if (!(p[0] == '['
+		&& ts_int(p + 1, 2, &dt->day) && p[3] == '/'
+		&& ts_month(p + 4, &dt->month) && p[7] == '/'
+		&& ts_int(p + 8, 4, &year) && p[12] == ':'
+		&& ts_hms(p + 13, dt) && p[21] == ' '
+		&& ts_zone(p + 22, 5) == 5 && p[27] == ']'))
+		return 0;
+	dt->year = year;
+	return 28;
+}
+
+/** UNIX time in seconds "1656230400[.123]" or milliseconds "1656230400123" */
+static int ts_epoch(uint fmt, const char *p, ffsize n, fftime *t)
+{
+	uint ndig = (fmt == TSF_EPOCH) ? 10 : 13;
+	uint64 v = 0;
+	uint i;
+	for (i = 0;  i < ffmin(n, ndig + 1);  i++) {
+		uint d = (ffbyte)p[i] - '0';
+		if (d > 9)
+			break;
+		v = v * 10 + d;
+	}
+	if (i != ndig || p[0] == '0')
+		return 0;
+
+	if (fmt == TSF_EPOCH) {
+		t->sec = v;
+		t->nsec = 0;
+		i += ts_frac(p + i, n - i, &t->nsec);
+	} else {
+		t->sec = v / 1000;
+		t->nsec = (v % 1000) * 1000000;
+	}
+	t->sec += FFTIME_1970_SECONDS;
+	return i;
+}
+
+/** Parse timestamp in the specified format
+fmt: enum TS_FMT
+Return N of bytes processed;  0 on error */
+static int ts_parse(struct arlg_conf *conf, uint fmt, const char *p, ffsize n, fftime *t)
+{
+	ffdatetime dt = {};
+	int r;
+
+	switch (fmt) {
+	case TSF_ISO: {
+		ffstr ss = FFSTR_INITN(p, n);
+		if (conf->date_fmt & 0x0f) {
+			if (0 != _fftime_date_fromstr(&dt, &ss, conf->date_fmt))
+				return 0;
+			if (conf->date_fmt & 0xf0) {
+				if (ss.len == 0 || !(ss.ptr[0] == ' ' || ss.ptr[0] == 'T'))
+					return 0;
+				ffstr_shift(&ss, 1);
+			}
+		}
 
-	if (conf->date_fmt & 0x0f) {
-		if (0 != _fftime_date_fromstr(&dt, &ss, conf->date_fmt))
-			goto end;
 		if (conf->date_fmt & 0xf0) {
-			if (ss.len == 0)
-				goto end;
-			if (!(ss.ptr[0] == ' ' || ss.ptr[0] == 'T'))
+			if (0 != _fftime_time_fromstr(&dt, &ss, conf->date_fmt))
 				return 0;
-			ffstr_shift(&ss, 1);
 		}
+		r = n - ss.len;
+		break;
 	}
 
-	if (conf->date_fmt & 0xf0) {
-		if (0 != _fftime_time_fromstr(&dt, &ss, conf->date_fmt))
-			goto end;
+	case TSF_RFC3339:
+		r = ts_rfc3339(p, n, &dt);  break;
+	case TSF_SYSLOG:
+		r = ts_syslog(conf, p, n, &dt);  break;
+	case TSF_NGINX:
+		r = ts_nginx(p, n, &dt);  break;
+
+	case TSF_EPOCH:
+	case TSF_EPOCH_MS:
+		return ts_epoch(fmt, p, n, t);
+
+	default:
+		return 0;
 	}
 
-	fftime_join1(t, &dt);
-	return s->len - ss.len;
+	if (r != 0)
+		fftime_join1(t, &dt);
+	return r;
+}
+
+/** Get the offset of N-th space-separated field (from 1) within line */
+static ffssize ts_field_find(const ffstr *s, uint field)
+{
+	ffsize i = 0;
+	for (uint k = 1;  k < field;  k++) {
+		for (;;) {
+			if (i == s->len || s->ptr[i] == '\n')
+				return -1;
+			if (s->ptr[i++] == ' ')
+				break;
+		}
+		while (i != s->len && s->ptr[i] == ' ') {
+			i++;
+		}
+	}
+	return i;
+}
+
+/** Find the value of "KEY" in a JSON object within line.
+Search for ':' and check that the key precedes it.
+Return offset of the value (after the opening quote of a string);
+ -1 if not found */
+static ffssize ts_json_find(const ffstr *key, const ffstr *s)
+{
+	ffsize i = 0;
+	for (;;) {
+		ffssize r = ffsimd_findany2(s->ptr + i, s->len - i, ':', '\n');
+		if (r < 0 || s->ptr[i + r] == '\n')
+			return -1;
+		i += r + 1;
+
+		ffsize k = i - 1;
+		while (k != 0 && s->ptr[k - 1] == ' ') {
+			k--;
+		}
+		// "KEY":
+		if (k >= key->len + 2
+			&& s->ptr[k - 1] == '"'
+			&& s->ptr[k - key->len - 2] == '"'
+			&& !ffmem_cmp(&s->ptr[k - key->len - 1], key->ptr, key->len)
+			&& !(k >= key->len + 3 && s->ptr[k - key->len - 3] == '\\'))
+			break;
+	}
+
+	while (i != s->len && s->ptr[i] == ' ') {
+		i++;
+	}
+	if (i != s->len && s->ptr[i] == '"')
+		i++;
+	return i;
+}
+
+/** Set the maximum length of data needed for parsing the timestamp */
+static void ts_len_update(struct arlg_conf *conf)
+{
+	uint n = 0;
+	switch (conf->ts_fmt) {
+	case TSF_ISO:
+		if (conf->date_fmt & 0x0f)
+			n = FFS_LEN("yyyy-MM-dd") + !!(conf->date_fmt & 0xf0);
+		if ((conf->date_fmt & 0xf0) == FFTIME_HMS_MSEC)
+			n += FFS_LEN("hh:mm:ss.msc");
+		else if (conf->date_fmt & 0xf0)
+			n += FFS_LEN("hh:mm:ss");
+		break;
+	case TSF_RFC3339:
+		n = FFS_LEN("yyyy-MM-ddThh:mm:ss.123456789+hh:mm");  break;
+	case TSF_SYSLOG:
+		n = FFS_LEN("Mmm dd hh:mm:ss");  break;
+	case TSF_NGINX:
+		n = FFS_LEN("[dd/Mmm/yyyy:hh:mm:ss +zzzz]");  break;
+	case TSF_EPOCH:
+		n = FFS_LEN("1656230400.123456789");  break;
+	case TSF_EPOCH_MS:
+		n = FFS_LEN("1656230400123");  break;
+	}
+	if (conf->ts_key.len != 0) {
+		n += TS_JSON_MAXOFF;
+	} else {
+		n += conf->ts_offset;
+		if (conf->ts_field > 1)
+			n += TS_FIELD_MAXOFF;
+	}
+	conf->date_len = n;
+}
+
+/** Get the range of the first character of a line that may have a timestamp */
+void ts_lead(struct arlg_conf *conf, ffbyte *lo, ffbyte *hi)
+{
+	*lo = 0,  *hi = 0xff;
+	if (conf->ts_key.len != 0) {
+		*lo = *hi = '{';
+		return;
+	}
+	if (conf->ts_field > 1 || conf->ts_offset != 0)
+		return;
+
+	switch (conf->ts_fmt) {
+	case TSF_ISO:
+	case TSF_RFC3339:
+	case TSF_EPOCH:
+	case TSF_EPOCH_MS:
+		*lo = '0',  *hi = '9';  break;
+	case TSF_SYSLOG:
+		*lo = 'A',  *hi = 'Z';  break;
+	case TSF_NGINX:
+		*lo = *hi = '[';  break;
+	}
+}
+
+/** Get the offset of timestamp within line
+Return -1 if not found */
+static ffssize ts_locate(struct arlg_conf *conf, const ffstr *s)
+{
+	ffssize off = 0;
+	if (conf->ts_key.len != 0)
+		return ts_json_find(&conf->ts_key, s);
+
+	if (conf->ts_field > 1) {
+		if (0 > (off = ts_field_find(s, conf->ts_field)))
+			return -1;
+	}
+	return off + conf->ts_offset;
+}
+
+/** Parse timestamp at the beginning of line (or at the configured field/offset/JSON key)
+Return >0: success (N of bytes up to the end of timestamp)
+ <0: need more data
+ 0: error */
+int date_parse_exact(struct arlg_conf *conf, const ffstr *s, fftime *t)
+{
+	ffssize off;
+	int r;
+
+	if (0 > (off = ts_locate(conf, s))
+		|| (ffsize)off >= s->len)
+		goto end;
+
+	if (0 == (r = ts_parse(conf, conf->ts_fmt, s->ptr + off, s->len - off, t)))
+		goto end;
+	if (conf->ts_fmt == TSF_ISO
+		&& (conf->date_fmt & 0xf0) && (conf->date_fmt & 0xf0) != FFTIME_HMS_MSEC)
+		ts_frac(s->ptr + off + r, s->len - off - r, &t->nsec); // the layout is from a user-specified date without fraction
+	return off + r;
 
 end:
 	if (s->len < conf->date_len)
@@ -104,43 +459,645 @@ end:
 	return 0;
 }
 
+/** Parse timestamp with the precision of user-specified dates */
+int date_parse(struct arlg_conf *conf, const ffstr *s, fftime *t)
+{
+	int r = date_parse_exact(conf, s, t);
+	if (r > 0 && !conf->ts_frac)
+		t->nsec = 0;
+	return r;
+}
+
+/** Detect timestamp format from a user-specified date */
+static int ts_detect_str(struct arlg_conf *conf, const ffstr *s)
+{
+	static const ffbyte fmts[] = {
+		TSF_ISO, TSF_RFC3339, TSF_SYSLOG, TSF_NGINX, TSF_EPOCH, TSF_EPOCH_MS,
+	};
+	fftime t;
+	for (uint i = 0;  i < FF_COUNT(fmts);  i++) {
+		if (fmts[i] == TSF_ISO && 0 != conf_iso(conf, *s))
+			continue;
+		if (s->len == (ffsize)ts_parse(conf, fmts[i], s->ptr, s->len, &t)) {
+			conf->ts_fmt = fmts[i];
+			ts_len_update(conf);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/** Return 1 if the data matches the sortable timestamp layout */
+static int date_lex_valid(struct arlg_conf *conf, const char *p)
+{
+	uint64 w[4] = {}, tmpl[4], d, bad = 0;
+	ffmem_copy(w, p, conf->lex.len);
+	ffmem_copy(tmpl, conf->lex.tmpl, sizeof(tmpl));
+	for (uint i = 0;  i < (conf->lex.len + 7) / 8;  i++) {
+		d = w[i] ^ 0x3030303030303030ULL; // '0'..'9' -> 0..9
+		bad |= ((((d & 0x7f7f7f7f7f7f7f7fULL) + 0x7676767676767676ULL) | d)
+			& 0x8080808080808080ULL & conf->lex.digit_mask[i]);
+		bad |= (w[i] ^ tmpl[i]) & conf->lex.lit_mask[i];
+	}
+	if (bad != 0)
+		return 0;
+
+	uint i = conf->lex.split;
+	if (i != (uint)-1 && !(p[i] == ' ' || p[i] == 'T'))
+		return 0;
+	return 1;
+}
+
+static int date_lex_cmp(struct arlg_conf *conf, const char *p, const char *bound)
+{
+	uint n = conf->lex.len, split = ffmin(conf->lex.split, n);
+	int r = ffmem_cmp(p, bound, split);
+	if (r == 0 && split != n)
+		r = ffmem_cmp(p + split + 1, bound + split + 1, n - split - 1);
+	return r;
+}
+
+/** Prepare the parse-free comparison for the layouts that sort the same as their bytes:
+ "yyyy-MM-dd", "hh:mm:ss[.msc]" and their combination */
+static void date_lex_init(struct arlg_conf *conf)
+{
+	static const char date_tmpl[] = "0000-00-00";
+	static const char time_tmpl[] = "00:00:00.000";
+	uint n = 0;
+	char *t = conf->lex.tmpl;
+
+	conf->lex.len = 0;
+	ffmem_zero(conf->lex.tmpl, sizeof(conf->lex.tmpl));
+	ffmem_zero(conf->lex.digit_mask, sizeof(conf->lex.digit_mask));
+	ffmem_zero(conf->lex.lit_mask, sizeof(conf->lex.lit_mask));
+	if (conf->ts_fmt != TSF_ISO || conf->ts_field > 1 || conf->ts_key.len != 0)
+		return;
+
+	if ((conf->date_fmt & 0x0f) == FFTIME_DATE_YMD) {
+		ffmem_copy(t, date_tmpl, FFS_LEN(date_tmpl));
+		n = FFS_LEN(date_tmpl);
+		if (conf->date_fmt & 0xf0)
+			t[n++] = ' ';
+	} else if (conf->date_fmt & 0x0f) {
+		return;
+	}
+	conf->lex.split = (n != 0 && t[n-1] == ' ') ? n-1 : (uint)-1;
+
+	switch (conf->date_fmt & 0xf0) {
+	case FFTIME_HMS_MSEC:
+		ffmem_copy(&t[n], time_tmpl, FFS_LEN(time_tmpl));
+		n += FFS_LEN(time_tmpl);
+		break;
+	case FFTIME_HMS:
+		ffmem_copy(&t[n], time_tmpl, FFS_LEN("hh:mm:ss"));
+		n += FFS_LEN("hh:mm:ss");
+		break;
+	case 0:
+		break;
+	default:
+		return;
+	}
+	if (n == 0 || n + conf->ts_offset != conf->date_len)
+		return;
+
+	// Build the masks checking 8 bytes at once:
+	//  each digit byte must be within '0'..'9', each literal byte must match the template
+	for (uint i = 0;  i < n;  i++) {
+		if (t[i] == '0')
+			((ffbyte*)conf->lex.digit_mask)[i] = 0xff;
+		else if (i != conf->lex.split)
+			((ffbyte*)conf->lex.lit_mask)[i] = 0xff;
+	}
+	conf->lex.len = n;
+
+	// the dates must be in the same layout as the lines
+	if ((conf->start_date.sec != 0
+			&& !(conf->lex.start_len == n && date_lex_valid(conf, conf->lex.start)))
+		|| (conf->end_date.sec != 0
+			&& !(conf->lex.end_len == n && date_lex_valid(conf, conf->lex.end)))) {
+		conf->lex.len = 0;
+		return;
+	}
+	dbglog(conf, "using parse-free date comparison: '%*s'", (ffsize)n, t);
+}
+
+/** Compare the timestamp at the beginning of line with start or end date.
+Sortable layouts are compared byte by byte without parsing.
+bound: enum DATE_BOUND
+dc: (optional) the last result: skip comparison if the line has the same timestamp prefix
+cmp: [output] <0: line is before the date;  0: equal;  >0: line is after the date
+Return the same as date_parse() */
+int date_cmp(struct arlg_conf *conf, const ffstr *s, uint bound, struct date_cache *dc, int *cmp)
+{
+	int r;
+	uint n = conf->date_len;
+
+	if (dc != NULL && dc->len == n && s->len >= n
+		&& !ffmem_cmp(s->ptr, dc->prefix, n)) {
+		*cmp = dc->cmp;
+		return dc->r;
+	}
+
+	if (conf->lex.len != 0) {
+		if (s->len < n)
+			return -1;
+		const char *p = s->ptr + conf->ts_offset;
+		if (!date_lex_valid(conf, p))
+			return 0;
+		r = n;
+		*cmp = date_lex_cmp(conf, p, (bound == DATE_START) ? conf->lex.start : conf->lex.end);
+
+	} else {
+		fftime t;
+		if (0 >= (r = date_parse(conf, s, &t)))
+			return r;
+		*cmp = fftime_cmp(&t, (bound == DATE_START) ? &conf->start_date : &conf->end_date);
+	}
+
+	if (dc != NULL && n <= sizeof(dc->prefix)) {
+		ffmem_copy(dc->prefix, s->ptr, n);
+		dc->len = n;
+		dc->r = r;
+		dc->cmp = *cmp;
+	}
+	return r;
+}
+
+/** Count the lines with a valid timestamp */
+static uint ts_detect_score(struct arlg_conf *conf, const ffstr *lines, uint n)
+{
+	uint k = 0;
+	fftime t;
+	ts_len_update(conf);
+	for (uint i = 0;  i < n;  i++) {
+		if (date_parse(conf, &lines[i], &t) > 0)
+			k++;
+	}
+	return k;
+}
+
+/** Detect timestamp format and position from the first lines of file.
+The format derived from the user-specified dates is preferred if it matches. */
+void ts_detect(struct arlg_conf *conf, const char *data, ffsize len)
+{
+	static const ffbyte fmts[] = {
+		TSF_ISO, TSF_RFC3339, TSF_SYSLOG, TSF_NGINX, TSF_EPOCH, TSF_EPOCH_MS,
+	};
+	static const char json_keys[][12] = {
+		"ts", "time", "timestamp", "@timestamp", "date", "t",
+	};
+	ffstr lines[16], d = FFSTR_INITN(data, len);
+	uint n = 0;
+	while (n < FF_COUNT(lines)) {
+		ffssize i = ffstr_findchar(&d, '\n');
+		if (i < 0)
+			break;
+		ffstr_set(&lines[n], d.ptr, i + 1);
+		ffstr_shift(&d, i + 1);
+		n++;
+	}
+	if (n == 0 && d.len != 0) {
+		// the first line is longer than data: its timestamp is at the beginning
+		lines[0] = d;
+		n = 1;
+	}
+
+	ffstr user_key = conf->ts_key;
+	struct {
+		uint fmt, date_fmt, field;
+		int key; // index in json_keys[];  -1: user-specified
+	} best = { conf->ts_fmt, conf->date_fmt, conf->ts_field, -1 };
+	uint best_score = ts_detect_score(conf, lines, n);
+	if (best_score * 2 > n)
+		goto end;
+
+	// Positions to try: JSON keys or space-separated fields
+	uint json_auto = (user_key.len == 0 && n != 0 && lines[0].ptr[0] == '{');
+	uint pos_first = 1, pos_last = 4;
+	if (user_key.len != 0)
+		pos_last = 1;
+	else if (json_auto)
+		pos_first = 0,  pos_last = FF_COUNT(json_keys) - 1;
+	else if (conf->ts_field != 0)
+		pos_first = pos_last = conf->ts_field;
+
+	for (uint pos = pos_first;  pos <= pos_last;  pos++) {
+		if (json_auto)
+			ffstr_setz(&conf->ts_key, json_keys[pos]);
+		else if (user_key.len == 0)
+			conf->ts_field = pos;
+
+		for (uint i = 0;  i < FF_COUNT(fmts);  i++) {
+			conf->ts_fmt = fmts[i];
+
+			if (fmts[i] == TSF_ISO) {
+				// get date/time layout from the first line that has it
+				uint k;
+				for (k = 0;  k < n;  k++) {
+					ffssize off = ts_locate(conf, &lines[k]);
+					if (off < 0 || (ffsize)off >= lines[k].len)
+						continue;
+					ffstr ts = lines[k];
+					ffstr_shift(&ts, off);
+					ts.len = ffmin(ts.len, FFS_LEN("yyyy-MM-dd hh:mm:ss.msc"));
+					if (0 == conf_iso(conf, ts))
+						break;
+				}
+				if (k == n)
+					continue;
+			}
+
+			uint score = ts_detect_score(conf, lines, n);
+			if (score > best_score) {
+				best_score = score;
+				best.fmt = conf->ts_fmt;
+				best.date_fmt = conf->date_fmt;
+				best.field = conf->ts_field;
+				best.key = (json_auto) ? (int)pos : -1;
+			}
+		}
+	}
+
+end:
+	conf->ts_fmt = best.fmt;
+	conf->date_fmt = best.date_fmt;
+	conf->ts_field = best.field;
+	conf->ts_key = user_key;
+	if (best.key >= 0)
+		ffstr_dupz(&conf->ts_key, json_keys[best.key]);
+	ts_len_update(conf);
+	dbglog(conf, "timestamp format: %u (%xu)  field:%u  offset:%u  key:'%S'  matched %u/%u lines"
+		, conf->ts_fmt, conf->date_fmt, conf->ts_field, conf->ts_offset, &conf->ts_key, best_score, n);
+	if (best_score == 0)
+		infolog(conf, "timestamp format: no timestamp found in the first %L bytes", len);
+	date_lex_init(conf);
+}
+
+/** Set the dates in the layout of the lines for parse-free comparison
+dates: enum ARLG_DATES_REL: the dates that were set by the program */
+static void conf_dates_lex(struct arlg_conf *conf, uint dates)
+{
+	if (conf->ts_fmt != TSF_ISO)
+		return;
+	ffdatetime dt;
+	if (dates & ARLG_REL_START) {
+		fftime_split1(&dt, &conf->start_date);
+		conf->lex.start_len = fftime_tostr1(&dt, conf->lex.start, sizeof(conf->lex.start), conf->date_fmt);
+	}
+	if (dates & ARLG_REL_END) {
+		fftime_split1(&dt, &conf->end_date);
+		conf->lex.end_len = fftime_tostr1(&dt, conf->lex.end, sizeof(conf->lex.end), conf->date_fmt);
+	}
+	date_lex_init(conf);
+}
+
+/** Set the missing year (or date) of a user-specified date from the first timestamp in file.
+The date before the first timestamp is in the next year (or day):
+ e.g. the log starts on Dec 31 and the date is Jan 1. */
+static void conf_date_complete(fftime *t, uint nodate, const fftime *first)
+{
+	ffdatetime dt, f;
+	fftime_split1(&dt, t);
+	fftime_split1(&f, first);
+	dt.year = f.year;
+	if (nodate) {
+		dt.month = f.month;
+		dt.day = f.day;
+	}
+	fftime_join1(t, &dt);
+	if (fftime_cmp(t, first) < 0) {
+		if (nodate) {
+			t->sec += 24*60*60;
+		} else {
+			dt.year++;
+			fftime_join1(t, &dt);
+		}
+	}
+}
+
+/** Complete the user-specified dates without year (syslog) or date (time only)
+ after the timestamp format of the file is detected.
+data: the first lines of file
+Return 0 on success */
+int conf_dates_complete(struct arlg_conf *conf, const char *data, ffsize len)
+{
+	uint dates = conf->dates_noyear | conf->dates_nodate;
+	if (dates == 0)
+		return 0;
+
+	if (conf->ts_fmt == TSF_SYSLOG) {
+		// the lines don't have a year either: use the same year for the dates
+		ffdatetime dt;
+		fftime *t[] = { &conf->start_date, &conf->end_date };
+		for (uint i = 0;  i != 2;  i++) {
+			if (!(conf->dates_noyear & (1 << i)) || conf->ts_year == 0)
+				continue;
+			fftime_split1(&dt, t[i]);
+			dt.year = conf->ts_year;
+			fftime_join1(t[i], &dt);
+		}
+
+	} else if (conf->ts_fmt != TSF_NONE
+		&& !(conf->ts_fmt == TSF_ISO && !(conf->date_fmt & 0x0f))) {
+		ffstr d = FFSTR_INITN(data, len), line;
+		fftime first;
+		for (;;) {
+			if (d.len == 0) {
+				errlog(conf, "the start/end date doesn't have a year and there's no timestamp in the first lines of file");
+				return 1;
+			}
+			ffstr_splitby(&d, '\n', &line, &d);
+			if (date_parse_exact(conf, &line, &first) > 0)
+				break;
+		}
+
+		if (dates & ARLG_REL_START)
+			conf_date_complete(&conf->start_date, conf->dates_nodate & ARLG_REL_START, &first);
+		if (dates & ARLG_REL_END)
+			conf_date_complete(&conf->end_date, conf->dates_nodate & ARLG_REL_END, &first);
+		dbglog(conf, "first timestamp: %Usec  start-date: %Usec  end-date: %Usec"
+			, first.sec, conf->start_date.sec, conf->end_date.sec);
+		conf_dates_lex(conf, dates);
+	}
+
+	if (conf->start_date.sec != 0 && conf->end_date.sec != 0 && !conf->dates_rel
+		&& fftime_cmp(&conf->start_date, &conf->end_date) > 0) {
+		errlog(conf, "end-date must be larger than start-date");
+		return 1;
+	}
+	return 0;
+}
+
+/** Set the relative dates from the newest timestamp in file
+Return 0 on success */
+int conf_dates_resolve(struct arlg_conf *conf, const fftime *newest)
+{
+	fftime d = {};
+	if (conf->dates_rel & ARLG_REL_START) {
+		conf->start_date = *newest;
+		d.sec = conf->start_ago;
+		fftime_sub(&conf->start_date, &d);
+	}
+	if (conf->dates_rel & ARLG_REL_END) {
+		conf->end_date = *newest;
+		d.sec = conf->end_ago;
+		fftime_sub(&conf->end_date, &d);
+	}
+	if (newest->nsec != 0 || conf->ts_fmt == TSF_EPOCH_MS)
+		conf->ts_frac = 1;
+	dbglog(conf, "newest timestamp: %Usec  start-date: %Usec  end-date: %Usec"
+		, newest->sec, conf->start_date.sec, conf->end_date.sec);
+
+	if (conf->start_date.sec != 0 && conf->end_date.sec != 0
+		&& fftime_cmp(&conf->start_date, &conf->end_date) > 0) {
+		errlog(conf, "end-date must be larger than start-date");
+		return 1;
+	}
+
+	conf_dates_lex(conf, conf->dates_rel);
+	return 0;
+}
+
 #define R_DONE  100
 #define R_BADVAL  101
 
 static int conf_infile(ffcmdarg_scheme *cs, struct arlg_conf *conf, char *s)
 {
-	ffmem_free(conf->filename);
+	if (conf->filename != NULL) {
+		*ffvec_pushT(&conf->inputs, char*) = ffsz_dup(s);
+		return 0;
+	}
 	conf->filename = ffsz_dup(s);
 	return 0;
 }
 
+/** Parse time interval: N[s|m|h|d]
+Return N of seconds;  0 on error */
+static uint interval_parse(const ffstr *s)
+{
+	static const char units[] = "smhd";
+	static const uint mult[] = { 1, 60, 60*60, 24*60*60 };
+	ffssize i;
+	uint n;
+	ffstr num = *s;
+	if (num.len != 0 && 0 <= (i = ffs_findchar(units, FFS_LEN(units), num.ptr[num.len - 1])))
+		num.len--;
+	else
+		i = 0;
+	if (!ffstr_toint(&num, &n, FFS_INT32) || n == 0
+		|| n > (uint)-1 / mult[i])
+		return 0;
+	return n * mult[i];
+}
+
+/** Parse relative date: -N[s|m|h|d] before the newest timestamp in file */
+static int conf_date_rel(struct arlg_conf *conf, uint start, const ffstr *s)
+{
+	ffstr v = FFSTR_INITN(s->ptr + 1, s->len - 1);
+	uint n;
+	if (0 == (n = interval_parse(&v))) {
+		errlog(conf, "bad relative date: %S", s);
+		return R_BADVAL;
+	}
+
+	// the date is set after the file is opened
+	fftime *t = (start) ? &conf->start_date : &conf->end_date;
+	t->sec = 1;
+	t->nsec = 0;
+	if (start) {
+		conf->dates_rel |= ARLG_REL_START;
+		conf->start_ago = n;
+	} else {
+		conf->dates_rel |= ARLG_REL_END;
+		conf->end_ago = n;
+	}
+	dbglog(conf, "%s-date: %usec before the newest timestamp", (start) ? "start" : "end", n);
+	return 0;
+}
+
 static int conf_startend(ffcmdarg_scheme *cs, struct arlg_conf *conf, ffstr *s)
 {
-	ffstr d = *s;
+	uint start = ffsz_eq(cs->arg->long_name, "start");
+	if (s->ptr[0] == '-')
+		return conf_date_rel(conf, start, s);
 
-	ffdatetime dt = {};
-	if (conf->date_fmt == 0) {
-		// detect datetime format
-		if (0 != conf_date(conf, &dt, &d))
-			return R_BADVAL;
-		if (d.len != 0) {
-			if (0 != conf_time(conf, &dt, &d))
-				return R_BADVAL;
-		}
+	// detect datetime format of each date;
+	//  the format of the first date is preferred by the detection from file data
+	uint prev_fmt = conf->ts_fmt, prev_date_fmt = conf->date_fmt;
+	if (0 != ts_detect_str(conf, s)) {
+		errlog(conf, "unsupported date-time format: %S", s);
+		return R_BADVAL;
 	}
 
-	if (ffsz_eq(cs->arg->long_name, "start")) {
-		if (s->len != date_parse(conf, s, &conf->start_date))
-			return R_BADVAL;
-		// fftime_join1(&conf->start_date, &dt);
-		dbglog("start-date: %Usec", conf->start_date.sec);
+	fftime *t = (start) ? &conf->start_date : &conf->end_date;
+	if (s->len != (ffsize)ts_parse(conf, conf->ts_fmt, s->ptr, s->len, t))
+		return R_BADVAL;
+
+	if (t->nsec != 0 || ffstr_findchar(s, '.') >= 0 || conf->ts_fmt == TSF_EPOCH_MS)
+		conf->ts_frac = 1;
 
+	uint date = (start) ? ARLG_REL_START : ARLG_REL_END;
+	conf->dates_noyear &= ~date;
+	conf->dates_nodate &= ~date;
+	if (conf->ts_fmt == TSF_SYSLOG) {
+		conf->dates_noyear |= date;
+	} else if (conf->ts_fmt == TSF_ISO && !(conf->date_fmt & 0x0f)) {
+		conf->dates_nodate |= date;
 	} else {
-		if (s->len != date_parse(conf, s, &conf->end_date))
+		// use the year for the lines that don't have it
+		ffdatetime dt;
+		fftime_split1(&dt, t);
+		conf->ts_year = dt.year;
+	}
+
+	if (prev_fmt != TSF_NONE) {
+		conf->ts_fmt = prev_fmt;
+		conf->date_fmt = prev_date_fmt;
+		ts_len_update(conf);
+	}
+
+	if (s->len <= sizeof(conf->lex.start)) {
+		if (start) {
+			ffmem_copy(conf->lex.start, s->ptr, s->len);
+			conf->lex.start_len = s->len;
+		} else {
+			ffmem_copy(conf->lex.end, s->ptr, s->len);
+			conf->lex.end_len = s->len;
+		}
+	}
+	dbglog(conf, "%s-date: %Usec", (start) ? "start" : "end", t->sec);
+	return 0;
+}
+
+static int conf_histogram(ffcmdarg_scheme *cs, struct arlg_conf *conf, ffstr *s)
+{
+	if (0 == (conf->hist_interval = interval_parse(s))) {
+		errlog(conf, "bad histogram interval: %S", s);
+		return R_BADVAL;
+	}
+	return 0;
+}
+
+/** Parse sampling rate: N (every N-th block) or N% */
+static int conf_sample(ffcmdarg_scheme *cs, struct arlg_conf *conf, ffstr *s)
+{
+	uint n;
+	ffstr num = *s;
+	uint percent = (num.len != 0 && num.ptr[num.len - 1] == '%');
+	if (percent)
+		num.len--;
+	if (!ffstr_toint(&num, &n, FFS_INT32) || n == 0 || (percent && n > 100)) {
+		errlog(conf, "bad sampling rate: %S", s);
+		return R_BADVAL;
+	}
+	conf->sample = (percent) ? n : 1;
+	conf->sample_per = (percent) ? 100 : n;
+	return 0;
+}
+
+/** Parse the list of ranges: N[-[M]][,...] */
+static int conf_ranges(struct arlg_conf *conf, ffstr s)
+{
+	ffstr it, lo, hi;
+	while (s.len != 0) {
+		ffstr_splitby(&s, ',', &it, &s);
+		struct arlg_range r;
+		ffssize dash = ffstr_splitby(&it, '-', &lo, &hi);
+		if (!ffstr_toint(&lo, &r.lo, FFS_INT32) || r.lo == 0)
+			return 1;
+		r.hi = r.lo;
+		if (dash >= 0) {
+			r.hi = (uint)-1;
+			if (hi.len != 0
+				&& (!ffstr_toint(&hi, &r.hi, FFS_INT32) || r.hi < r.lo))
+				return 1;
+		}
+
+		// insert in order, merge with the overlapping ranges
+		struct arlg_range *rr = conf->proj.ptr;
+		uint i, n = conf->proj.len;
+		for (i = 0;  i != n && rr[i].hi < r.lo - 1;  i++) {
+		}
+		uint k = i;
+		for (;  k != n && rr[k].lo - 1 <= r.hi;  k++) {
+			r.lo = ffmin(r.lo, rr[k].lo);
+			r.hi = ffmax(r.hi, rr[k].hi);
+		}
+		ffslice_rmT((ffslice*)&conf->proj, i, k - i, struct arlg_range);
+		rr = ffvec_growT(&conf->proj, 1, struct arlg_range);
+		ffmem_move(&rr[i + 1], &rr[i], (conf->proj.len - i) * sizeof(struct arlg_range));
+		rr[i] = r;
+		conf->proj.len++;
+	}
+	return 0;
+}
+
+static int conf_fields(ffcmdarg_scheme *cs, struct arlg_conf *conf, ffstr *s)
+{
+	uint columns = ffsz_eq(cs->arg->long_name, "columns");
+	if ((conf->proj.len != 0 && conf->proj_columns != columns)
+		|| 0 != conf_ranges(conf, *s)) {
+		errlog(conf, "bad list of fields or columns: %S", s);
+		return R_BADVAL;
+	}
+	conf->proj_columns = columns;
+	return 0;
+}
+
+static int conf_delim(ffcmdarg_scheme *cs, struct arlg_conf *conf, ffstr *s)
+{
+	if (s->len != 1 || s->ptr[0] == '\n') {
+		errlog(conf, "delimiter must be one character: %S", s);
+		return R_BADVAL;
+	}
+	conf->delim = s->ptr[0];
+	return 0;
+}
+
+static int conf_plugin(ffcmdarg_scheme *cs, struct arlg_conf *conf, char *s)
+{
+	*ffvec_pushT(&conf->plugins, char*) = ffsz_dup(s);
+	return 0;
+}
+
+static int conf_allow(ffcmdarg_scheme *cs, struct arlg_conf *conf, char *s)
+{
+	*ffvec_pushT(&conf->serve_allow, char*) = ffsz_dup(s);
+	return 0;
+}
+
+/** Parse octal file mode, e.g. 0660 */
+static int conf_serve_mode(ffcmdarg_scheme *cs, struct arlg_conf *conf, ffstr *s)
+{
+	uint mode = 0;
+	for (ffsize i = 0;  i != s->len;  i++) {
+		uint d = (ffbyte)s->ptr[i] - '0';
+		if (d > 7 || mode > 0777)
 			return R_BADVAL;
-		dbglog("end-date: %Usec", conf->end_date.sec);
+		mode = mode * 8 + d;
 	}
+	if (mode > 0777)
+		return R_BADVAL;
+	conf->serve_mode = mode;
+	return 0;
+}
 
+static int conf_probe(ffcmdarg_scheme *cs, struct arlg_conf *conf, ffint64 n)
+{
+	if (n <= 0 || n > 0xffffffff)
+		return R_BADVAL;
+	conf->read_chunk_size_small = n;
+	conf->probe_fixed = 1;
+	return 0;
+}
+
+static int conf_stats(ffcmdarg_scheme *cs, struct arlg_conf *conf, ffstr *s)
+{
+	if (!ffstr_eqz(s, "json")) {
+		errlog(conf, "unsupported statistics format: %S", s);
+		return R_BADVAL;
+	}
+	conf->stats = ARLG_STATS_JSON;
 	return 0;
 }
 
@@ -149,13 +1106,57 @@ static int conf_help()
 	static const char help[] =
 "archeolog v" ARLG_VER "\n\
 Usage:\n\
- archeolog [OPTIONS] FILE\n\
+ archeolog [OPTIONS] FILE...\n\
+ Several files: merge their lines by timestamp\n\
 \n\
 OPTIONS:\n\
  -s, --start=TIME  Start-datetime\n\
  -e, --end=TIME    End-datetime\n\
+                    -N[s|m|h|d]: relative to the newest timestamp in file\n\
+                    (e.g. -s -15m)\n\
  -l, --lines       Max N of output lines\n\
+ -f, --filter=TEXT Output only the lines containing TEXT\n\
+     --word        Filter: TEXT must not be a part of a longer word\n\
+     --index       Build or update the content index FILE.arlgidx and use it:\n\
+                    skip the blocks without the filter words,\n\
+                    narrow the start-date search by the block timestamps\n\
+     --records     Multi-line records: a line without timestamp\n\
+                    belongs to the previous line (stack traces)\n\
+     --histogram=INTERVAL\n\
+                   Print N of lines and bytes per time interval (e.g. 1m)\n\
+                    between start and end dates.\n\
+                    N of lines is estimated from the sampled data.\n\
+     --exact       Histogram: count the lines (reads the whole range)\n\
+     --sample=RATE Output the lines from every N-th block (N or N%)\n\
+                    between start and end dates\n\
+     --explain     Output the query cost estimate (JSON):\n\
+                    range offsets, N of lines, bytes to read from disk.\n\
+                    Only the start/end-date search blocks are read.\n\
+     --interp      Explain: estimate the range offsets by interpolation\n\
+                    between the first and the newest timestamps\n\
+     --fields=LIST Output only these fields of each line, e.g. 1,3-4,7-\n\
+     --delim=C     Field delimiter (=' ')\n\
+     --columns=LIST\n\
+                   Output only these columns (bytes) of each line, e.g. 1-19,25-\n\
+     --chain=LIST  Filters to process the data, e.g. file,startdate,data,out\n\
+                    Built-in: file startdate data match project sample hist explain out\n\
+     --plugin=FILE Load filters from a shared object (may be repeated)\n\
+     --serve=PATH  Process the queries from clients on Unix socket PATH\n\
+     --allow=DIR   Server: open only the files within this directory (required, may be repeated)\n\
+     --serve-mode=MODE\n\
+                   Server: access mode of the socket file (=0600)\n\
+     --threads     Read, process and write the data in parallel threads\n\
+     --stats=json  Print execution statistics to stderr\n\
+     --trace=FILE  Write timeline of filter calls, reads and writes\n\
+                    (Chrome trace-event format)\n\
+     --ts-field=N  Timestamp is in N-th space-separated field\n\
+     --ts-offset=N Timestamp offset in bytes\n\
+     --json=KEY    JSON lines: timestamp is the value of KEY\n\
      --buffer      File buffer in bytes (=8M)\n\
+     --probe=N     Block size for start-date search in bytes\n\
+                    (=4K, grows by read latency and line length)\n\
+     --align=N     File read offset alignment in bytes (=4K)\n\
+     --hugepages   Use 2MB memory pages for the buffers\n\
  -D, --debug       Debug logging\n\
  -h, --help        Show help\n\
 ";
@@ -168,7 +1169,33 @@ static const ffcmdarg_arg arlg_cmd_args[] = {
 	{ 's', "start",	FFCMDARG_TSTR | FFCMDARG_FNOTEMPTY, (ffsize)conf_startend },
 	{ 'e', "end",	FFCMDARG_TSTR | FFCMDARG_FNOTEMPTY, (ffsize)conf_startend },
 	{ 'l', "lines",	FFCMDARG_TINT64, FF_OFF(struct arlg_conf, max_lines) },
+	{ 'f', "filter",	FFCMDARG_TSTR | FFCMDARG_FNOTEMPTY, FF_OFF(struct arlg_conf, filter) },
+	{ 0, "word",	FFCMDARG_TSWITCH, FF_OFF(struct arlg_conf, filter_word) },
+	{ 0, "index",	FFCMDARG_TSWITCH, FF_OFF(struct arlg_conf, index) },
+	{ 0, "records",	FFCMDARG_TSWITCH, FF_OFF(struct arlg_conf, records) },
+	{ 0, "histogram",	FFCMDARG_TSTR | FFCMDARG_FNOTEMPTY, (ffsize)conf_histogram },
+	{ 0, "exact",	FFCMDARG_TSWITCH, FF_OFF(struct arlg_conf, hist_exact) },
+	{ 0, "sample",	FFCMDARG_TSTR | FFCMDARG_FNOTEMPTY, (ffsize)conf_sample },
+	{ 0, "explain",	FFCMDARG_TSWITCH, FF_OFF(struct arlg_conf, explain) },
+	{ 0, "interp",	FFCMDARG_TSWITCH, FF_OFF(struct arlg_conf, explain_interp) },
+	{ 0, "fields",	FFCMDARG_TSTR | FFCMDARG_FNOTEMPTY, (ffsize)conf_fields },
+	{ 0, "delim",	FFCMDARG_TSTR | FFCMDARG_FNOTEMPTY, (ffsize)conf_delim },
+	{ 0, "columns",	FFCMDARG_TSTR | FFCMDARG_FNOTEMPTY, (ffsize)conf_fields },
+	{ 0, "chain",	FFCMDARG_TSTR | FFCMDARG_FNOTEMPTY, FF_OFF(struct arlg_conf, chain) },
+	{ 0, "plugin",	FFCMDARG_TSTRZ | FFCMDARG_FNOTEMPTY | FFCMDARG_FMULTI, (ffsize)conf_plugin },
+	{ 0, "serve",	FFCMDARG_TSTRZ | FFCMDARG_FNOTEMPTY, FF_OFF(struct arlg_conf, serve) },
+	{ 0, "allow",	FFCMDARG_TSTRZ | FFCMDARG_FNOTEMPTY | FFCMDARG_FMULTI, (ffsize)conf_allow },
+	{ 0, "serve-mode",	FFCMDARG_TSTR | FFCMDARG_FNOTEMPTY, (ffsize)conf_serve_mode },
+	{ 0, "threads",	FFCMDARG_TSWITCH, FF_OFF(struct arlg_conf, threads) },
+	{ 0, "stats",	FFCMDARG_TSTR | FFCMDARG_FNOTEMPTY, (ffsize)conf_stats },
+	{ 0, "trace",	FFCMDARG_TSTRZ | FFCMDARG_FNOTEMPTY, FF_OFF(struct arlg_conf, trace) },
+	{ 0, "ts-field",	FFCMDARG_TINT32, FF_OFF(struct arlg_conf, ts_field) },
+	{ 0, "ts-offset",	FFCMDARG_TINT32, FF_OFF(struct arlg_conf, ts_offset) },
+	{ 0, "json",	FFCMDARG_TSTR | FFCMDARG_FNOTEMPTY, FF_OFF(struct arlg_conf, ts_key) },
 	{ 0, "buffer",	FFCMDARG_TINT32, FF_OFF(struct arlg_conf, read_chunk_size_large) },
+	{ 0, "probe",	FFCMDARG_TINT32, (ffsize)conf_probe },
+	{ 0, "align",	FFCMDARG_TINT32, FF_OFF(struct arlg_conf, read_chunk_align) },
+	{ 0, "hugepages",	FFCMDARG_TSWITCH, FF_OFF(struct arlg_conf, hugepages) },
 	{ 'D', "debug",	FFCMDARG_TSWITCH, FF_OFF(struct arlg_conf, debug) },
 	{ 'h', "help",	FFCMDARG_TSWITCH, (ffsize)conf_help },
 	{}
@@ -179,24 +1206,70 @@ void conf_init(struct arlg_conf *conf)
 	conf->read_chunk_size_small = 4*1024;
 	conf->read_chunk_size_large = 8*1024*1024;
 	conf->read_chunk_align = 4*1024;
+	conf->delim = ' ';
+	conf->serve_mode = 0600;
 }
 
 int conf_check(struct arlg_conf *conf)
 {
-	if (conf->filename == NULL) {
-		errlog("input file isn't specified");
+	if (conf->filename == NULL && conf->serve == NULL) {
+		errlog(conf, "input file isn't specified");
+		return 1;
+	}
+	if (conf->serve != NULL && conf->serve_allow.len == 0) {
+		errlog(conf, "--serve requires --allow=DIR: the directories with the files for queries");
 		return 1;
 	}
 	if (conf->start_date.sec != 0 && conf->end_date.sec != 0
+		&& !(conf->dates_rel | conf->dates_noyear | conf->dates_nodate) // checked after the file is opened
 		&& fftime_cmp(&conf->start_date, &conf->end_date) > 0) {
-		errlog("end-date must be larger than start-date");
+		errlog(conf, "end-date must be larger than start-date");
+		return 1;
+	}
+	if (conf->hist_interval != 0
+		&& (conf->start_date.sec == 0 || conf->end_date.sec == 0)) {
+		errlog(conf, "histogram: start and end dates are required");
 		return 1;
 	}
-	if (conf->read_chunk_size_large == 0) {
-		errlog("bad buffer size");
+	if (conf->sample != 0
+		&& (conf->start_date.sec == 0 || conf->end_date.sec == 0)) {
+		errlog(conf, "sample: start and end dates are required");
+		return 1;
+	}
+	if (conf->filter_word && conf->filter.len == 0) {
+		errlog(conf, "--word requires --filter");
+		return 1;
+	}
+	if (conf->explain_interp && !conf->explain) {
+		errlog(conf, "--interp requires --explain");
+		return 1;
+	}
+	if (conf->inputs.len != 0 && conf->explain) {
+		errlog(conf, "explain: several input files aren't supported");
+		return 1;
+	}
+	if (conf->inputs.len != 0 && conf->hist_interval != 0) {
+		errlog(conf, "histogram: several input files aren't supported");
+		return 1;
+	}
+	if (conf->inputs.len != 0 && conf->trace != NULL) {
+		errlog(conf, "trace: several input files aren't supported");
+		return 1;
+	}
+	if (conf->read_chunk_size_large == 0
+		|| conf->read_chunk_size_small == 0) {
+		errlog(conf, "bad buffer size");
 		return 1;
 	}
 	conf->read_chunk_size_small = ffmin(conf->read_chunk_size_small, conf->read_chunk_size_large);
+	if (!ffint_ispower2(conf->read_chunk_align)
+		|| conf->read_chunk_align < 512
+		|| conf->read_chunk_align > conf->read_chunk_size_small) {
+		// a block read from the aligned offset must contain the requested offset
+		errlog(conf, "alignment must be a power of 2 from 512 to probe size");
+		return 1;
+	}
+	ts_len_update(conf);
 	return 0;
 }
 
@@ -212,9 +1285,9 @@ int conf_cmdline(struct arlg_conf *conf, int argc, const char **argv)
 		if (r == -R_DONE)
 			goto err;
 		else if (r == -R_BADVAL)
-			ffstderr_fmt("command line: bad value\n");
+			errlog(conf, "command line: bad value");
 		else
-			ffstderr_fmt("command line: %S\n", &errmsg);
+			errlog(conf, "command line: %S", &errmsg);
 		goto err;
 	}
 
@@ -0,0 +1,230 @@
+/** archeolog: query cost estimate (--explain)
+2022, Simon Zolin */
+
+/*
+The range offsets are found by the start-date search (only the small blocks are read),
+ or with --interp they are estimated by interpolation between the first and the newest timestamps
+ (only the blocks at the file start and end are read).
+The N of lines is estimated from the data at the range boundaries.
+The page cache residency of the range is checked without reading the data (Linux: mincore()):
+ the range part that isn't in cache would be read from disk.
+The estimate is output as JSON object:
+
+{"file":"...", "method":"search", "start":123, "end":456, "bytes":333, "lines":10,
+ "cached_bytes":0, "disk_bytes":333, "reads":1, "probe_reads":17, "probe_bytes":69632}
+*/
+
+#define EXPLAIN_VEC  4096 // N of pages checked at once
+
+int explain_open(struct archeolog *a)
+{
+	if (!a->conf->explain) {
+		errlog(a->conf, "explain: isn't enabled");
+		return CHAIN_ERR;
+	}
+	return CHAIN_READY;
+}
+
+/** Get the average line length from the data at range boundary */
+static void explain_sample(struct archeolog *a, const ffstr *in)
+{
+	struct arlg_explain *x = &a->explain;
+	ffssize n = ffs_rfindchar(in->ptr, in->len, '\n');
+	if (n < 0)
+		return;
+	x->sample_size += n + 1;
+	x->sample_lines += ffsimd_count(in->ptr, n + 1, '\n');
+}
+
+/** Get N of bytes of the range in page cache
+Return -1 if unknown */
+static int64 explain_cached(struct archeolog *a, uint64 start, uint64 end)
+{
+	uint page = a->file.page_size;
+	ffbyte vec[EXPLAIN_VEC];
+	uint64 n = 0;
+	if (page == 0)
+		return -1;
+
+	uint64 off = ffint_align_floor2(start, page);
+	while (off < end) {
+		uint64 len = ffmin(end - off, (uint64)EXPLAIN_VEC * page);
+		if (0 != file_resident(a, off, len, vec))
+			return -1;
+		uint np = ffint_align_ceil2(len, page) / page;
+		for (uint i = 0;  i != np;  i++) {
+			if (vec[i] & 1)
+				n += page;
+		}
+		off += len;
+	}
+	return ffmin(n, end - start);
+}
+
+static double explain_usec(const fftime *t)
+{
+	return (double)t->sec * 1000000 + t->nsec / 1000;
+}
+
+/** Estimate the offset of the first line at or after 't' */
+static uint64 explain_interp_off(struct archeolog *a, const fftime *t, const fftime *t0, uint64 off0)
+{
+	const struct arlg_file *f = &a->file;
+	if (fftime_cmp(t, t0) <= 0)
+		return off0;
+	if (fftime_cmp(t, &f->newest) > 0)
+		return f->data_end;
+	double k = (explain_usec(t) - explain_usec(t0)) / (explain_usec(&f->newest) - explain_usec(t0));
+	return off0 + (uint64)(k * (f->newest_off - off0));
+}
+
+/** Estimate the range offsets by interpolation
+Return 0 on success */
+static int explain_interp(struct archeolog *a)
+{
+	struct arlg_explain *x = &a->explain;
+	struct arlg_file *f = &a->file;
+	x->start = 0;
+	x->end = f->data_end;
+	if (a->conf->start_date.sec == 0 && a->conf->end_date.sec == 0)
+		return 0;
+
+	// the first timestamp: in the data read by the timestamp format detection
+	int64 off0 = 0;
+	if (f->sparse)
+		off0 = ffmax(fffile_data_next(f->fd, 0), 0);
+	const struct fcache_buf *b = fcache_find(&f->cache, off0);
+	if (b == NULL) {
+		errlog(a->conf, "explain: can't find the first timestamp");
+		return -1;
+	}
+	ffstr d = FFSTR_INITN(b->ptr, b->len), line;
+	ffstr_shift(&d, off0 - b->off);
+	explain_sample(a, &d);
+	fftime t0;
+	for (;;) {
+		if (d.len == 0) {
+			errlog(a->conf, "explain: can't find the first timestamp");
+			return -1;
+		}
+		ffstr_splitby(&d, '\n', &line, &d);
+		if (date_parse_exact(a->conf, &line, &t0) > 0)
+			break;
+		off0 += line.len + 1;
+	}
+
+	if (0 != file_newest(a))
+		return -1;
+	if (fftime_cmp(&f->newest, &t0) <= 0)
+		return 0;
+
+	if (a->conf->start_date.sec != 0)
+		x->start = explain_interp_off(a, &a->conf->start_date, &t0, off0);
+	if (a->conf->end_date.sec != 0) {
+		fftime t = a->conf->end_date, d = {};
+		if (a->conf->ts_frac)
+			d.nsec = 1;
+		else
+			d.sec = 1;
+		fftime_add(&t, &d);
+		x->end = explain_interp_off(a, &t, &t0, off0);
+	}
+	x->end = ffmax(x->end, x->start);
+	return 0;
+}
+
+/** Output the estimate
+Return 0 on success */
+static int explain_print(struct archeolog *a)
+{
+	struct arlg_explain *x = &a->explain;
+	uint64 size = x->end - x->start, lines = 0;
+	if (x->sample_size == 0 && size != 0) {
+		// no data at the range boundaries (no start-date): read a block at the range start
+		uint n = ffmin(a->conf->read_chunk_size_small, size);
+		char *p = ffmem_alloc(n);
+		int r;
+		if (p != NULL && 0 < (r = file_zero_read(a, p, n, x->start))) {
+			ffstr d = FFSTR_INITN(p, r);
+			explain_sample(a, &d);
+		}
+		ffmem_free(p);
+	}
+	if (x->sample_size != 0)
+		lines = size * x->sample_lines / x->sample_size;
+	int64 cached = explain_cached(a, x->start, x->end);
+	uint64 disk = (cached >= 0) ? size - cached : size;
+	uint64 reads = (size + a->conf->read_chunk_size_large - 1) / a->conf->read_chunk_size_large;
+
+	ffvec buf = {};
+	ffvec_addsz(&buf, "{\"file\":\"");
+	json_escape_add(&buf, a->conf->filename);
+	ffvec_addfmt(&buf, "\", \"method\":\"%s\", \"start\":%U, \"end\":%U, \"bytes\":%U, \"lines\":%U"
+		", \"cached_bytes\":%D, \"disk_bytes\":%U, \"reads\":%U"
+		", \"probe_reads\":%U, \"probe_bytes\":%U}\n"
+		, (a->conf->explain_interp) ? "interp" : "search"
+		, x->start, x->end, size, lines
+		, cached, disk, reads
+		, a->stats.reads, a->stats.read_bytes);
+	int r = arlg_output(a->conf, buf.ptr, buf.len);
+	ffvec_free(&buf);
+	return r;
+}
+
+/** Return enum CHAIN_R */
+int explain_process(struct archeolog *a, ffstr *in, ffstr *out)
+{
+	struct arlg_explain *x = &a->explain;
+	enum { X_START, X_END };
+	fftime d = {}, t;
+
+	if (a->conf->explain_interp) {
+		if (0 != explain_interp(a))
+			return CHAIN_ERR;
+		goto done;
+	}
+
+	switch (x->state) {
+	case X_START: {
+		// the start-date search has found the first line of the range
+		//  (without start-date the range starts at the data start: no input data)
+		uint from_start = (a->conf->start_date.sec == 0);
+		x->start = x->end = a->off;
+		explain_sample(a, in);
+		if (a->conf->end_date.sec == 0) {
+			x->end = a->file.data_end;
+			break;
+		}
+
+		// search for the first line after end-date
+		a->conf->start_date = a->conf->end_date;
+		if (a->conf->ts_frac)
+			d.nsec = 1;
+		else
+			d.sec = 1;
+		fftime_add(&a->conf->start_date, &d);
+		a->conf->lex.len = 0;
+
+		if (!from_start
+			&& (in->len == 0
+				|| (date_parse(a->conf, in, &t) > 0 && fftime_cmp(&t, &a->conf->start_date) >= 0)))
+			break; // the range is empty
+
+		startdate_restart(a, x->start + !from_start);
+		x->state = X_END;
+		return CHAIN_PREV;
+	}
+
+	case X_END:
+		x->end = a->off;
+		explain_sample(a, in);
+		break;
+	}
+
+done:
+	if (0 != explain_print(a))
+		return CHAIN_ERR;
+	return CHAIN_FIN;
+}
+
+struct filter_if filter_explain = { "explain", explain_open, NULL, explain_process };
@@ -1,6 +1,7 @@
 /** archeolog: file cache
 2022, Simon Zolin */
 
+#include <util/arena.h>
 #include <ffbase/slice.h>
 
 // can cast to ffstr*
@@ -12,21 +13,29 @@ struct fcache_buf {
 
 struct fcache {
 	ffslice bufs; // struct fcache_buf[]
+	ffarena *arena; // owner of the buffers' memory;  NULL: buffers are allocated separately
 	ffuint idx;
 	struct {
 		ffuint64 hits, misses;
 	};
 };
 
-int fcache_init(struct fcache *c, ffuint nbufs, ffuint bufsize, ffuint align)
+/**
+arena: allocate the buffers from arena (may be NULL) */
+int fcache_init(struct fcache *c, ffuint nbufs, ffuint bufsize, ffuint align, ffarena *arena)
 {
 	if (NULL == ffslice_zallocT(&c->bufs, nbufs, struct fcache_buf))
 		return 1;
 	c->bufs.len = nbufs;
+	c->arena = arena;
 
 	struct fcache_buf *b;
 	FFSLICE_WALK(&c->bufs, b) {
-		if (NULL == (b->ptr = ffmem_align(bufsize, align)))
+		if (arena != NULL)
+			b->ptr = ffarena_alloc(arena, bufsize, align);
+		else
+			b->ptr = ffmem_align(bufsize, align);
+		if (b->ptr == NULL)
 			return 1;
 		b->off = (ffuint64)-1;
 	}
@@ -37,7 +46,8 @@ void fcache_destroy(struct fcache *c)
 {
 	struct fcache_buf *b;
 	FFSLICE_WALK(&c->bufs, b) {
-		ffmem_alignfree(b->ptr);
+		if (c->arena == NULL)
+			ffmem_alignfree(b->ptr);
 	}
 	ffslice_free(&c->bufs);
 }
@@ -3,40 +3,309 @@
 
 #include <FFOS/file.h>
 #include <FFOS/error.h>
+#ifdef FF_UNIX
+#include <sys/mman.h>
+#endif
+
+#define TS_DETECT_SIZE  (64*1024)
+#define FILE_ZERO_BLOCK  4096
+#define FILE_NEWEST_MAX  (1*1024*1024) // max block size for the newest timestamp search
+
+static void index_open(struct archeolog *a);
+static void index_close(struct archeolog *a);
+static uint64 index_next(struct archeolog *a, uint64 off, uint64 *end);
+
+/** Detect timestamp format from the first lines of file.
+The data stays in cache.
+Return 0 on success */
+static int file_ts_detect(struct archeolog *a)
+{
+	struct arlg_file *f = &a->file;
+	struct fcache_buf *b = fcache_nextbuf(&f->cache);
+	uint n = ffmin(TS_DETECT_SIZE, a->conf->read_chunk_size_large);
+	int64 off = 0;
+	if (f->sparse)
+		off = ffmax(fffile_data_next(f->fd, 0), 0); // the file starts with a hole
+	fftime t;
+	if (a->conf->trace != NULL)
+		t = fftime_monotonic();
+	int r = fffile_readat(f->fd, b->ptr, n, off);
+	if (a->conf->trace != NULL)
+		trace_add(a, "read", "io", t, ffmax(r, 0), 0, NULL);
+	a->stats.reads++;
+	if (r <= 0)
+		return 0;
+	a->stats.read_bytes += r;
+	b->off = off;
+	b->len = r;
+	ffstr d = FFSTR_INITN(b->ptr, b->len);
+	if (f->sparse)
+		ffstr_trim_zeros(&d);
+	ts_detect(a->conf, d.ptr, d.len);
+	return conf_dates_complete(a->conf, d.ptr, d.len);
+}
+
+/** Read a block for the end of data search or the newest timestamp search */
+static int file_zero_read(struct archeolog *a, char *buf, uint n, uint64 off)
+{
+	fftime t;
+	if (a->conf->trace != NULL)
+		t = fftime_monotonic();
+	int r = fffile_readat(a->file.fd, buf, n, off);
+	if (a->conf->trace != NULL)
+		trace_add(a, "read", "io", t, ffmax(r, 0), 0, NULL);
+	a->stats.reads++;
+	if (r > 0)
+		a->stats.read_bytes += r;
+	return r;
+}
+
+/** Find the end of data within [from..size):
+ skip the holes at the end, then the zero bytes at the end of the last data region
+ (preallocated space, or the space which is being written).
+Zero bytes are expected only at the end: a block of zeros can't be a part of text lines.
+The zero blocks are checked back from the end at growing distance, then bisected.
+Return the offset after the last non-zero byte;  'from': there's no data */
+static uint64 file_data_end(struct archeolog *a, uint64 from, uint64 size)
+{
+	fffd fd = a->file.fd;
+	uint64 data = from, end = size;
+	char buf[FILE_ZERO_BLOCK];
+	uint64 buf_off = (uint64)-1;
+	int r;
+
+	// find the last data region
+	for (uint64 off = from;  off < size;  ) {
+		int64 d = fffile_data_next(fd, off), h;
+		if (d < 0) {
+			end = off; // there's no data after the hole
+			break;
+		}
+		if (0 > (h = fffile_hole_next(fd, d)))
+			break; // holes aren't supported
+		data = d;
+		end = ffmin((uint64)h, size);
+		off = h;
+	}
+	if (data >= end)
+		return from;
+
+	// [zero..end) contains only zero bytes;  the block at 'nz' contains non-zero bytes
+	uint64 zero = end, nz;
+	for (uint64 dist = FILE_ZERO_BLOCK;  ;  dist *= 2) {
+		uint64 off = data;
+		if (end - data > dist)
+			off = ffmax(ffint_align_floor2(end - dist, FILE_ZERO_BLOCK), data);
+		uint n = ffmin(FILE_ZERO_BLOCK, zero - off);
+		if (0 >= (r = file_zero_read(a, buf, n, off)))
+			return end;
+		buf_off = off;
+		if (!ffmem_zeroed(buf, r)) {
+			nz = off;
+			break;
+		}
+		zero = off;
+		if (off == data)
+			return data; // the whole region is zeros
+	}
+
+	while (zero - nz > FILE_ZERO_BLOCK) {
+		uint64 mid = nz + ffmax(ffint_align_floor2((zero - nz) / 2, FILE_ZERO_BLOCK), FILE_ZERO_BLOCK);
+		uint n = ffmin(FILE_ZERO_BLOCK, zero - mid);
+		if (0 >= (r = file_zero_read(a, buf, n, mid)))
+			return end;
+		buf_off = mid;
+		if (ffmem_zeroed(buf, r))
+			zero = mid;
+		else
+			nz = mid;
+	}
+
+	// the last non-zero byte
+	if (buf_off != nz
+		&& 0 >= (r = file_zero_read(a, buf, zero - nz, nz)))
+		return end;
+	uint n = zero - nz;
+	while (n != 0 && buf[n - 1] == '\0') {
+		n--;
+	}
+	return nz + n;
+}
+
+/** Find the end of data after 'from' */
+static void file_data_detect(struct archeolog *a, uint64 from)
+{
+	struct arlg_file *f = &a->file;
+	f->data_end_checked = 1;
+	f->data_end = file_data_end(a, from, f->size);
+	if (f->data_end != f->size)
+		dbglog(a->conf, "file: data end: %U (%U bytes of zeros or holes at the end)"
+			, f->data_end, f->size - f->data_end);
+}
+
+/** The file is being written (it grows, or the zero bytes at its end are overwritten):
+ find the end of data again
+Return 1 if there's more data */
+static int file_data_more(struct archeolog *a)
+{
+	struct arlg_file *f = &a->file;
+	uint64 size = fffile_size(f->fd);
+	if ((int64)size < 0
+		|| (size == f->size && f->data_end == f->size))
+		return 0;
+	f->size = size;
+	file_data_detect(a, f->cur);
+	return (f->data_end > f->cur);
+}
+
+/** Find the line with the newest timestamp (the last line with a valid timestamp).
+The file is read backward from the end of data in aligned blocks;
+ the block size doubles while no line is found (long lines or lines without timestamp).
+Return 0 on success */
+static int file_newest(struct archeolog *a)
+{
+	struct arlg_file *f = &a->file;
+	uint64 align = a->conf->read_chunk_align;
+	uint64 n = ffmax(a->conf->read_chunk_size_small, align);
+	uint64 hi = f->data_end; // check the lines starting before this offset
+	char *buf = NULL;
+	ffsize cap = 0;
+	int rc = -1;
+
+	if (a->conf->ts_fmt == TSF_NONE) {
+		errlog(a->conf, "newest timestamp: timestamp format isn't detected");
+		return -1;
+	}
+
+	while (hi != 0) {
+		uint64 lo = (hi > n) ? ffint_align_floor2(hi - n, align) : 0;
+		// the line starting near 'hi' needs the data after it
+		ffsize len = ffmin(hi + a->conf->date_len, f->data_end) - lo;
+		if (len > cap) {
+			ffmem_free(buf);
+			cap = len;
+			if (NULL == (buf = ffmem_alloc(cap))) {
+				errlog(a->conf, "no memory");
+				return -1;
+			}
+		}
+		int r = file_zero_read(a, buf, len, lo);
+		if (r < 0) {
+			errlog(a->conf, "file read: %E", fferr_last());
+			goto end;
+		}
+
+		// walk the line starts back from 'hi'
+		ffsize i = ffmin(hi - lo, (ffsize)r);
+		// skip the newline at the end of data;
+		//  in the previous blocks the line starting at 'hi' hasn't been checked yet
+		uint skip = (hi == f->data_end);
+		while (i != 0) {
+			ffssize k = ffs_rfindchar(buf, i - skip, '\n');
+			skip = 1;
+			if (k < 0 && lo != 0)
+				break; // the line starts in the previous block
+			ffsize ls = k + 1;
+			ffstr line = FFSTR_INITN(buf + ls, r - ls);
+			ffssize e = ffstr_findchar(&line, '\n');
+			if (e >= 0)
+				line.len = e;
+			if (date_parse_exact(a->conf, &line, &f->newest) > 0) {
+				f->newest_off = lo + ls;
+				dbglog(a->conf, "file: newest timestamp: '%*s' @%U"
+					, ffmin(line.len, a->conf->date_len), line.ptr, f->newest_off);
+				rc = 0;
+				goto end;
+			}
+			i = ls;
+		}
+		hi = lo;
+		n = ffmin(n * 2, FILE_NEWEST_MAX);
+	}
+	errlog(a->conf, "can't find the newest timestamp");
+
+end:
+	ffmem_free(buf);
+	return rc;
+}
 
 int file_open(struct archeolog *a)
 {
 	struct arlg_file *f = &a->file;
 	f->fd = FFFILE_NULL;
+	a->index.fd = FFFILE_NULL;
 	f->read_chunk_size = a->conf->read_chunk_size_large;
+	f->seq = 1;
 	f->seek = (uint64)-1;
+#ifdef FF_UNIX
+	f->page_size = sysconf(_SC_PAGESIZE);
+#endif
 
-	if (FFFILE_NULL == (f->fd = fffile_open(a->conf->filename, FFFILE_READONLY | FFFILE_NOATIME))) {
-		errlog("file open: %s: %E", a->conf->filename, fferr_last());
+	if (a->conf->shared_if != NULL)
+		f->fd = a->conf->shared_if->file_open(a->conf->shared, a->conf->filename);
+	else
+		f->fd = fffile_open(a->conf->filename, FFFILE_READONLY | FFFILE_NOATIME);
+	if (f->fd == FFFILE_NULL) {
+		errlog(a->conf, "file open: %s: %E", a->conf->filename, fferr_last());
 		return CHAIN_ERR;
 	}
 
 	f->size = fffile_size(f->fd);
 	if ((int64)f->size < 0) {
-		errlog("file size: %E", fferr_last());
+		errlog(a->conf, "file size: %E", fferr_last());
 		return CHAIN_ERR;
 	}
 
-	dbglog("file open: %s (%U)", a->conf->filename, f->size);
-	if (0 != fcache_init(&f->cache, 1, a->conf->read_chunk_size_large, a->conf->read_chunk_align))
+	dbglog(a->conf, "file open: %s (%U)", a->conf->filename, f->size);
+	f->data_end = f->size;
+	int64 hole = fffile_hole_next(f->fd, 0);
+	if (hole >= 0 && (uint64)hole < f->size) {
+		f->sparse = 1;
+		// the byte offsets are counted by the histogram
+		f->skip_holes = !a->conf->hist_interval;
+		dbglog(a->conf, "file: sparse: the first hole @%U", hole);
+	}
+	if (a->conf->start_date.sec != 0 || a->conf->dates_rel)
+		file_data_detect(a, 0);
+
+	if (0 != fcache_init(&f->cache, 1, a->conf->read_chunk_size_large, a->conf->read_chunk_align, &a->arena))
 		return CHAIN_ERR;
+
+	if (a->conf->start_date.sec != 0 || a->conf->end_date.sec != 0
+		|| a->conf->records || a->conf->index) {
+		if (0 != file_ts_detect(a))
+			return CHAIN_ERR;
+	}
+	if (a->conf->dates_rel
+		&& (0 != file_newest(a)
+			|| 0 != conf_dates_resolve(a->conf, (a->conf->newest.sec != 0) ? &a->conf->newest : &f->newest)))
+		return CHAIN_ERR;
+	if (a->conf->index)
+		index_open(a);
 	return CHAIN_NEXT;
 }
 
 void file_close(struct archeolog *a)
 {
 	struct arlg_file *f = &a->file;
+	reader_destroy(a);
+	if (a->conf->index)
+		index_close(a);
+#ifdef FF_UNIX
+	if (f->map != NULL) {
+		munmap(f->map, f->map_size);
+		f->map = NULL;
+	}
+#endif
 	if (f->fd != FFFILE_NULL) {
-		fffile_close(f->fd);
+		if (a->conf->shared_if != NULL)
+			a->conf->shared_if->file_close(a->conf->shared, f->fd);
+		else
+			fffile_close(f->fd);
 		f->fd = FFFILE_NULL;
 	}
 	fcache_destroy(&f->cache);
-	dbglog("file: cache-hits:%U  cache-miss:%U"
+	dbglog(a->conf, "file: cache-hits:%U  cache-miss:%U"
 		, f->cache.hits, f->cache.misses);
 }
 
@@ -46,44 +315,127 @@ int file_read(struct archeolog *a, ffstr *in, ffstr *out)
 	struct arlg_file *f = &a->file;
 	if (f->seek != (uint64)-1) {
 		f->cur = f->seek;
-		dbglog("file seek: %U", f->seek);
+		dbglog(a->conf, "file seek: %U", f->seek);
 		f->seek = (uint64)-1;
 	} else if (f->read_last) {
 		// next filters didn't ask for new data
-		return CHAIN_DONE;
+		if (!(f->seq && file_data_more(a)))
+			return CHAIN_DONE;
+		f->read_last = 0;
 	}
 
 	struct fcache_buf *b;
 	if (NULL != (b = fcache_find(&f->cache, f->cur))) {
-		dbglog("cache hit: %L @%U", b->len, b->off);
+		dbglog(a->conf, "cache hit: %L @%U", b->len, b->off);
 		ffstr_setstr(out, b);
 		ffstr_shift(out, f->cur - b->off);
+		if (b->off + b->len > f->data_end) {
+			out->len = (f->cur < f->data_end) ? f->data_end - f->cur : 0;
+			f->read_last = 1;
+		}
 		f->cur += out->len;
 		return CHAIN_NEXT;
 	}
 
+	if (a->conf->threads && f->seq && !a->index.skip)
+		return reader_read(a, out);
+
+	if (f->seq && f->skip_holes) {
+		int64 d = fffile_data_next(f->fd, f->cur);
+		if (d < 0)
+			d = f->data_end;
+		if ((uint64)d > f->cur) {
+			dbglog(a->conf, "file: skipping hole @%U..%U", f->cur, d);
+			f->cur = d;
+		}
+	}
+	uint64 index_end = (uint64)-1;
+	if (f->seq && a->index.skip) {
+		uint64 d = index_next(a, f->cur, &index_end);
+		if (d > f->cur) {
+			dbglog(a->conf, "file: index: skipping %U..%U", f->cur, d);
+			f->cur = d;
+			// the line before the gap can't match the filter text with this ending
+			ffstr_setz(out, "_\n");
+			return CHAIN_NEXT;
+		}
+	}
+	if (f->cur >= f->data_end) {
+		f->read_last = 1;
+		ffstr_null(out);
+		return CHAIN_NEXT;
+	}
+
 	b = fcache_nextbuf(&f->cache);
 	b->off = ffint_align_floor2(f->cur, a->conf->read_chunk_align);
+	uint n = ffmin(f->read_chunk_size, f->data_end - b->off);
+	if (index_end != (uint64)-1)
+		n = ffmin(n, index_end - b->off); // don't read the blocks without the filter words
+	if (f->seq && f->skip_holes) {
+		// don't read past the next hole
+		int64 h = fffile_hole_next(f->fd, f->cur);
+		if (h > 0 && (uint64)h < b->off + n)
+			n = h - b->off;
+	}
+
+	const struct arlg_shared_if *sh = a->conf->shared_if;
+	// the blocks of random access (the probe size may be adapted): shared by offset and size
+	uint shared_block = (sh != NULL && !f->seq);
+	if (shared_block
+		&& 0 != (b->len = sh->block_get(a->conf->shared, f->fd, b->off, b->ptr, f->read_chunk_size))) {
+		dbglog(a->conf, "shared cache hit: %L @%U", b->len, b->off);
+		f->read_last = 0;
+		ffstr_setstr(out, b);
+		ffstr_shift(out, f->cur - b->off);
+		f->cur = b->off + b->len;
+		return CHAIN_NEXT;
+	}
+
 	fftime start, end;
-	if (a->conf->debug)
+	if (a->conf->debug || a->conf->stats || a->conf->trace != NULL || !f->seq)
 		start = fftime_monotonic();
-	int r = fffile_readat(f->fd, b->ptr, f->read_chunk_size, b->off);
+	int r = fffile_readat(f->fd, b->ptr, n, b->off);
+	a->stats.reads++;
+	if (a->conf->trace != NULL)
+		trace_add(a, "read", "io", start, ffmax(r, 0), 0, NULL);
 	if (r <= 0) {
 		if (r < 0)
-			errlog("file read: %E", fferr_last());
+			errlog(a->conf, "file read: %E", fferr_last());
 		return CHAIN_ERR;
 	}
-	if (a->conf->debug) {
+	if (a->conf->debug || a->conf->stats || !f->seq) {
 		end = fftime_monotonic();
 		fftime_sub(&end, &start);
+		a->stats.read_usec += fftime_usec(&end);
+		if (!f->seq) {
+			f->rand_reads++;
+			f->rand_read_usec += fftime_usec(&end);
+		}
 	}
+	a->stats.read_bytes += r;
 	b->len = r;
-	f->read_last = (r < f->read_chunk_size);
-	dbglog("file read: %u @%U(%u%%)  last:%u  %uus"
+	if (f->seq && !f->data_end_checked && b->ptr[r - 1] == '\0') {
+		// zero bytes at the end of file
+		file_data_detect(a, b->off);
+		if (f->data_end <= f->cur) {
+			b->len = 0;
+			f->read_last = 1;
+			ffstr_null(out);
+			return CHAIN_NEXT;
+		}
+		b->len = ffmin(b->len, f->data_end - b->off);
+		r = b->len;
+	}
+	f->read_last = ((uint)r < n || b->off + r >= f->data_end);
+	if (shared_block && !f->read_last)
+		sh->block_put(a->conf->shared, f->fd, b->off, b->ptr, r); // only full blocks: the file may grow
+	dbglog(a->conf, "file read: %u @%U(%u%%)  last:%u  %uus"
 		, b->len, b->off, (int)(b->off * 100 / f->size), f->read_last, fftime_usec(&end));
 	ffstr_setstr(out, b);
 	ffstr_shift(out, f->cur - b->off);
 	f->cur = b->off + r;
+	if (f->seq && f->skip_holes)
+		ffstr_trim_zeros(out);
 	return CHAIN_NEXT;
 }
 
@@ -92,20 +444,56 @@ int arlg_file_behaviour(struct archeolog *a, uint flags)
 	struct arlg_file *f = &a->file;
 	switch (flags) {
 	case FBEH_SEQ:
-		dbglog("file: sequential access");
+		dbglog(a->conf, "file: sequential access");
 		a->file.read_chunk_size = a->conf->read_chunk_size_large;
+		f->seq = 1;
 		if (0 != fffile_readahead(f->fd, f->size))
-			dbglog("file read ahead: %E", fferr_last());
+			dbglog(a->conf, "file read ahead: %E", fferr_last());
 		break;
 
 	case FBEH_RANDOM:
-		dbglog("file: random access");
+		dbglog(a->conf, "file: random access");
 		f->read_chunk_size = a->conf->read_chunk_size_small;
+		f->seq = 0;
+		reader_stop(a);
 		break;
 	}
 	return 0;
 }
 
+/** Get page cache residency of the file pages
+The file is mapped (but not read) once for all calls.
+off: page-aligned
+vec: [out] bit 0 is set for each resident page
+Return 0 on success */
+static int file_resident(struct archeolog *a, uint64 off, ffsize len, ffbyte *vec)
+{
+#ifdef FF_UNIX
+	struct arlg_file *f = &a->file;
+	if (f->map == NULL) {
+		if (f->size == 0 || (ffsize)f->size != f->size)
+			return -1;
+		void *m = mmap(NULL, f->size, PROT_READ, MAP_SHARED, f->fd, 0);
+		if (m == MAP_FAILED) {
+			f->page_size = 0; // don't try again
+			return -1;
+		}
+		f->map = m;
+		f->map_size = f->size;
+	}
+	if (off + len > ffint_align_ceil2(f->map_size, f->page_size))
+		return -1;
+	return mincore((char*)f->map + off, len, (void*)vec);
+#else
+	return -1;
+#endif
+}
+
+void arlg_file_probe(struct archeolog *a, uint size)
+{
+	a->file.read_chunk_size = size;
+}
+
 void arlg_file_seek(struct archeolog *a, uint64 off)
 {
 	struct arlg_file *f = &a->file;
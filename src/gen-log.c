@@ -0,0 +1,327 @@
+/** archeolog: generate a large log file for benchmarks
+2022, Simon Zolin */
+
+/*
+Usage:
+ gen-log [OPTIONS] FILE
+ gen-log --evict FILE
+
+Each line: "yyyy-MM-dd hh:mm:ss.msc id=N xxx...\n", the first line is at 2022-06-26 00:00:00.
+--evict removes the file data from the page cache (cold-cache benchmarks).
+*/
+
+#include <util/cmdarg-scheme.h>
+#include <FFOS/file.h>
+#include <FFOS/std.h>
+#include <FFOS/error.h>
+#include <FFOS/time.h>
+
+#define GEN_BUF_SIZE  (1*1024*1024)
+#define GEN_LINE_MIN  64 // timestamp, id and filler
+#define GEN_LINE_MAX  (64*1024)
+#define GEN_RATE_MAX  1000000 // the interval between lines is counted in microseconds
+
+enum GEN_DIST {
+	GEN_UNIFORM,
+	GEN_EXP, // most lines are short, a few are long
+};
+
+struct gen_conf {
+	char *filename;
+	ffuint64 size; // output file size
+	ffuint line_min, line_max; // line length
+	ffuint dist; // enum GEN_DIST
+	ffuint rate; // average N of lines per second
+	ffuint gap_permille; // probability of a gap after a line
+	ffuint gap; // max gap (seconds)
+	ffuint disorder_permille; // probability of an out-of-order timestamp
+	ffuint disorder; // max time shift back (msec)
+	ffuint seed;
+	ffbyte evict;
+};
+
+static ffuint64 gen_seed;
+static fftime gen_start; // the first line's time
+
+/** xorshift64 */
+static ffuint64 gen_rand()
+{
+	ffuint64 x = gen_seed;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	gen_seed = x;
+	return x;
+}
+
+/** Random number in range [0..n) */
+static ffuint64 gen_rand_n(ffuint64 n)
+{
+	return (n != 0) ? gen_rand() % n : 0;
+}
+
+static ffuint gen_line_len(struct gen_conf *g)
+{
+	ffuint n = g->line_max - g->line_min + 1;
+	if (g->dist == GEN_EXP) {
+		// N of trailing zero bits is geometrically distributed: each next step is 2 times less probable
+		ffuint step = ffmax(n / 16, 1);
+		ffuint k = __builtin_ctzll(gen_rand() | (1ULL << 63));
+		return g->line_min + ffmin(k * step + gen_rand_n(step), n - 1);
+	}
+	return g->line_min + gen_rand_n(n);
+}
+
+/** Write "yyyy-MM-dd hh:mm:ss.msc" */
+static void gen_ts(char *d, ffuint64 msec)
+{
+	static ffuint64 sec_cached = (ffuint64)-1;
+	static char date_cached[32];
+	ffuint64 sec = msec / 1000;
+	if (sec != sec_cached) {
+		sec_cached = sec;
+		fftime t = gen_start;
+		t.sec += sec;
+		ffdatetime dt;
+		fftime_split1(&dt, &t);
+		fftime_tostr1(&dt, date_cached, sizeof(date_cached), FFTIME_DATE_YMD | FFTIME_HMS);
+	}
+	ffmem_copy(d, date_cached, FFS_LEN("yyyy-MM-dd hh:mm:ss"));
+	ffuint ms = msec % 1000;
+	d += FFS_LEN("yyyy-MM-dd hh:mm:ss");
+	d[0] = '.';
+	d[1] = '0' + ms / 100;
+	d[2] = '0' + ms / 10 % 10;
+	d[3] = '0' + ms % 10;
+}
+
+static int gen(struct gen_conf *g)
+{
+	static const char filler[] = "lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod tempor ";
+	int rc = 1;
+	fffd f = FFFILE_NULL;
+	char *buf = NULL;
+	ffsize n = 0;
+	ffuint64 total = 0, lines = 0, gaps = 0, disordered = 0;
+	ffuint64 interval_us = 1000000 / g->rate, us = 0;
+
+	if (NULL == (buf = ffmem_alloc(GEN_BUF_SIZE + 64*1024)))
+		goto end;
+	if (FFFILE_NULL == (f = fffile_open(g->filename, FFFILE_CREATE | FFFILE_TRUNCATE | FFFILE_WRITEONLY))) {
+		ffstderr_fmt("file open: %s: %E\n", g->filename, fferr_last());
+		goto end;
+	}
+
+	while (total + n < g->size) {
+		ffuint64 ts = us / 1000;
+		if (gen_rand_n(1000) < g->disorder_permille) {
+			ts -= ffmin(ts, gen_rand_n(g->disorder) + 1);
+			disordered++;
+		}
+
+		char *d = buf + n;
+		ffuint len = gen_line_len(g);
+		gen_ts(d, ts);
+		ffsize i = FFS_LEN("yyyy-MM-dd hh:mm:ss.msc");
+		i += ffs_format(d + i, 32, " id=%U ", lines);
+		while (i < len - 1) {
+			ffsize k = ffmin(len - 1 - i, FFS_LEN(filler));
+			ffmem_copy(d + i, filler, k);
+			i += k;
+		}
+		d[i++] = '\n';
+		n += i;
+		lines++;
+
+		// time of the next line: random interval with the specified average rate
+		us += gen_rand_n(interval_us * 2 + 1);
+		if (gen_rand_n(1000) < g->gap_permille) {
+			us += (gen_rand_n(g->gap) + 1) * 1000000;
+			gaps++;
+		}
+
+		if (n >= GEN_BUF_SIZE) {
+			if ((ffssize)n != fffile_write(f, buf, n)) {
+				ffstderr_fmt("file write: %s: %E\n", g->filename, fferr_last());
+				goto end;
+			}
+			total += n;
+			n = 0;
+		}
+	}
+
+	if (n != 0 && (ffssize)n != fffile_write(f, buf, n)) {
+		ffstderr_fmt("file write: %s: %E\n", g->filename, fferr_last());
+		goto end;
+	}
+	total += n;
+	ffstdout_fmt("%s: %U bytes  %U lines  %Usec  gaps:%U  disordered:%U\n"
+		, g->filename, total, lines, us / 1000000, gaps, disordered);
+	rc = 0;
+
+end:
+	if (f != FFFILE_NULL)
+		fffile_close(f);
+	ffmem_free(buf);
+	return rc;
+}
+
+/** Remove file data from the page cache */
+static int evict(struct gen_conf *g)
+{
+#ifdef FF_UNIX
+	int rc = 1;
+	fffd f = fffile_open(g->filename, FFFILE_READONLY);
+	if (f == FFFILE_NULL) {
+		ffstderr_fmt("file open: %s: %E\n", g->filename, fferr_last());
+		return 1;
+	}
+	if (0 != fdatasync(f)
+		|| 0 != posix_fadvise(f, 0, 0, POSIX_FADV_DONTNEED)) {
+		ffstderr_fmt("evict: %s: %E\n", g->filename, fferr_last());
+		goto end;
+	}
+	rc = 0;
+end:
+	fffile_close(f);
+	return rc;
+#else
+	ffstderr_fmt("evict: not supported on this OS\n");
+	return 1;
+#endif
+}
+
+#define R_DONE  100
+#define R_BADVAL  101
+
+static int gen_infile(ffcmdarg_scheme *cs, struct gen_conf *g, char *s)
+{
+	ffmem_free(g->filename);
+	g->filename = ffsz_dup(s);
+	return 0;
+}
+
+/** Parse size: N[k|m|g] */
+static int gen_size(ffcmdarg_scheme *cs, struct gen_conf *g, ffstr *s)
+{
+	static const char units[] = "kmg";
+	ffssize i;
+	ffstr num = *s;
+	if (num.len != 0 && 0 <= (i = ffs_findchar(units, FFS_LEN(units), num.ptr[num.len - 1] | 0x20)))
+		num.len--;
+	else
+		i = -1;
+	if (!ffstr_toint(&num, &g->size, FFS_INT64) || g->size == 0)
+		return R_BADVAL;
+	g->size <<= (i + 1) * 10;
+	return 0;
+}
+
+/** Parse line length range: MIN-MAX */
+static int gen_line(ffcmdarg_scheme *cs, struct gen_conf *g, ffstr *s)
+{
+	ffstr lo, hi;
+	ffstr_splitby(s, '-', &lo, &hi);
+	if (!ffstr_toint(&lo, &g->line_min, FFS_INT32)
+		|| !ffstr_toint(&hi, &g->line_max, FFS_INT32))
+		return R_BADVAL;
+	return 0;
+}
+
+static int gen_dist(ffcmdarg_scheme *cs, struct gen_conf *g, ffstr *s)
+{
+	if (ffstr_eqz(s, "uniform"))
+		g->dist = GEN_UNIFORM;
+	else if (ffstr_eqz(s, "exp"))
+		g->dist = GEN_EXP;
+	else
+		return R_BADVAL;
+	return 0;
+}
+
+static int gen_help()
+{
+	static const char help[] =
+"Generate a log file for benchmarks\n\
+Usage:\n\
+ gen-log [OPTIONS] FILE\n\
+ gen-log --evict FILE\n\
+\n\
+OPTIONS:\n\
+     --size=N[k|m|g]   File size (=1g)\n\
+     --line=MIN-MAX    Line length within 64-65536 (=64-256)\n\
+     --dist=NAME       Line length distribution (=uniform):\n\
+                        uniform, exp (most lines are short, a few are long)\n\
+     --rate=N          Average N of lines per second, max 1000000 (=1000)\n\
+     --gaps=N          N of gaps per 1000 lines (=0)\n\
+     --gap=SEC         Max gap length (=600)\n\
+     --disorder=N      N of out-of-order timestamps per 1000 lines (=0)\n\
+     --disorder-ms=N   Max time shift of an out-of-order timestamp (=1000)\n\
+     --seed=N          Random seed\n\
+     --evict           Remove the file data from the page cache\n\
+ -h, --help            Show help\n\
+";
+	ffstdout_write(help, FFS_LEN(help));
+	return R_DONE;
+}
+
+static const ffcmdarg_arg gen_args[] = {
+	{ 0, "",	FFCMDARG_TSTRZ | FFCMDARG_FNOTEMPTY, (ffsize)gen_infile },
+	{ 0, "size",	FFCMDARG_TSTR | FFCMDARG_FNOTEMPTY, (ffsize)gen_size },
+	{ 0, "line",	FFCMDARG_TSTR | FFCMDARG_FNOTEMPTY, (ffsize)gen_line },
+	{ 0, "dist",	FFCMDARG_TSTR | FFCMDARG_FNOTEMPTY, (ffsize)gen_dist },
+	{ 0, "rate",	FFCMDARG_TINT32, FF_OFF(struct gen_conf, rate) },
+	{ 0, "gaps",	FFCMDARG_TINT32, FF_OFF(struct gen_conf, gap_permille) },
+	{ 0, "gap",	FFCMDARG_TINT32, FF_OFF(struct gen_conf, gap) },
+	{ 0, "disorder",	FFCMDARG_TINT32, FF_OFF(struct gen_conf, disorder_permille) },
+	{ 0, "disorder-ms",	FFCMDARG_TINT32, FF_OFF(struct gen_conf, disorder) },
+	{ 0, "seed",	FFCMDARG_TINT32, FF_OFF(struct gen_conf, seed) },
+	{ 0, "evict",	FFCMDARG_TSWITCH, FF_OFF(struct gen_conf, evict) },
+	{ 'h', "help",	FFCMDARG_TSWITCH, (ffsize)gen_help },
+	{}
+};
+
+int main(int argc, const char **argv)
+{
+	struct gen_conf g = {
+		.size = 1024*1024*1024,
+		.line_min = 64, .line_max = 256,
+		.rate = 1000,
+		.gap = 600,
+		.disorder = 1000,
+		.seed = 1,
+	};
+	ffstr errmsg = {};
+	int r = ffcmdarg_parse_object(gen_args, &g, argv, argc, 0, &errmsg);
+	if (r < 0) {
+		if (r == -R_BADVAL)
+			ffstderr_fmt("command line: bad value\n");
+		else if (r != -R_DONE)
+			ffstderr_fmt("command line: %S\n", &errmsg);
+		ffstr_free(&errmsg);
+		return r != -R_DONE;
+	}
+
+	if (g.filename == NULL || g.rate == 0 || g.gap == 0) {
+		ffstderr_fmt("bad arguments: see --help\n");
+		ffmem_free(g.filename);
+		return 1;
+	}
+	if (g.line_min < GEN_LINE_MIN || g.line_min > g.line_max || g.line_max > GEN_LINE_MAX) {
+		ffstderr_fmt("--line: MIN-MAX must be within %u-%u\n", GEN_LINE_MIN, GEN_LINE_MAX);
+		ffmem_free(g.filename);
+		return 1;
+	}
+	if (g.rate > GEN_RATE_MAX) {
+		ffstderr_fmt("--rate: must be at most %u\n", GEN_RATE_MAX);
+		ffmem_free(g.filename);
+		return 1;
+	}
+	gen_seed = 0x9e3779b97f4a7c15ULL * (g.seed + 1);
+	ffdatetime dt = { .year = 2022, .month = 6, .day = 26 };
+	fftime_join1(&gen_start, &dt);
+
+	r = (g.evict) ? evict(&g) : gen(&g);
+	ffmem_free(g.filename);
+	return r;
+}
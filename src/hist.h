@@ -0,0 +1,174 @@
+/** archeolog: time histogram
+2022, Simon Zolin */
+
+/*
+Bucket boundaries are found by the start-date search, so only a few small blocks are read.
+N of lines in a bucket is estimated from the average line length in the data read by the search,
+ or (--exact) the lines are counted by reading the whole range.
+*/
+
+int hist_open(struct archeolog *a)
+{
+	struct arlg_hist *h = &a->hist;
+	if (a->conf->hist_interval == 0) {
+		errlog(a->conf, "hist: interval isn't specified");
+		return CHAIN_ERR;
+	}
+	h->start = h->t = a->conf->start_date;
+	h->end = a->conf->end_date;
+	// the last bucket includes the lines with end-date
+	fftime d = {};
+	if (a->conf->ts_frac)
+		d.nsec = 1;
+	else
+		d.sec = 1;
+	fftime_add(&h->end, &d);
+
+	// the start-date is moved to each bucket boundary: parse the lines for comparison
+	a->conf->lex.len = 0;
+	return CHAIN_READY;
+}
+
+void hist_close(struct archeolog *a)
+{
+	struct arlg_hist *h = &a->hist;
+	ffvec_free(&h->offs);
+	ffvec_free(&h->lines);
+}
+
+/** Get the average line length from the data at bucket boundary */
+static void hist_sample(struct archeolog *a, const ffstr *in)
+{
+	struct arlg_hist *h = &a->hist;
+	ffssize n = ffs_rfindchar(in->ptr, in->len, '\n');
+	if (n < 0)
+		return;
+	h->sample_size += n + 1;
+	h->sample_lines += ffsimd_count(in->ptr, n + 1, '\n');
+}
+
+/** Count lines in buckets */
+static void hist_count(struct archeolog *a, ffstr d)
+{
+	struct arlg_hist *h = &a->hist;
+	const uint64 *offs = h->offs.ptr;
+	uint64 *lines = h->lines.ptr;
+
+	while (d.len != 0 && h->ib + 1 < h->offs.len) {
+		if (h->off >= offs[h->ib + 1]) {
+			h->ib++;
+			continue;
+		}
+		ffsize n = ffmin(d.len, offs[h->ib + 1] - h->off);
+		lines[h->ib] += ffsimd_count(d.ptr, n, '\n');
+		h->last_char = d.ptr[n - 1];
+		ffstr_shift(&d, n);
+		h->off += n;
+	}
+}
+
+/** Return 0 on success */
+static int hist_print(struct archeolog *a)
+{
+	struct arlg_hist *h = &a->hist;
+	const uint64 *offs = h->offs.ptr, *lines = h->lines.ptr;
+	uint64 n, total_size = 0, total_lines = 0;
+	fftime t = h->start;
+	fftime interval = { a->conf->hist_interval, 0 };
+	ffdatetime dt;
+	char date[64];
+	ffvec buf = {};
+
+	for (uint i = 0;  i + 1 < h->offs.len;  i++) {
+		uint64 size = offs[i + 1] - offs[i];
+		if (a->conf->hist_exact)
+			n = lines[i];
+		else if (h->sample_size != 0)
+			n = size * h->sample_lines / h->sample_size;
+		else
+			n = 0;
+		total_size += size;
+		total_lines += n;
+
+		fftime_split1(&dt, &t);
+		ffsize r = fftime_tostr1(&dt, date, sizeof(date), FFTIME_YMD);
+		ffvec_addfmt(&buf, "%*s  lines:%s%U  bytes:%U\n"
+			, r, date, (a->conf->hist_exact) ? "" : "~", n, size);
+		fftime_add(&t, &interval);
+	}
+	ffvec_addfmt(&buf, "total  lines:%s%U  bytes:%U\n"
+		, (a->conf->hist_exact) ? "" : "~", total_lines, total_size);
+	int r = arlg_output(a->conf, buf.ptr, buf.len);
+	ffvec_free(&buf);
+	return r;
+}
+
+/** Return enum CHAIN_R */
+int hist_process(struct archeolog *a, ffstr *in, ffstr *out)
+{
+	struct arlg_hist *h = &a->hist;
+	enum { H_BOUND, H_COUNT };
+	fftime t, interval = { a->conf->hist_interval, 0 };
+
+	switch (h->state) {
+	case H_BOUND:
+		// the start-date search has found the first line of the bucket
+		*ffvec_pushT(&h->offs, uint64) = a->off;
+		hist_sample(a, in);
+
+		for (;;) {
+			if (fftime_cmp(&h->t, &h->end) >= 0)
+				goto bounds_done;
+
+			fftime_add(&h->t, &interval);
+			if (fftime_cmp(&h->t, &h->end) > 0)
+				h->t = h->end;
+
+			if (in->len == 0
+				|| (date_parse(a->conf, in, &t) > 0 && fftime_cmp(&t, &h->t) >= 0)) {
+				// empty bucket
+				*ffvec_pushT(&h->offs, uint64) = a->off;
+				continue;
+			}
+			break;
+		}
+
+		a->conf->start_date = h->t;
+		startdate_restart(a, a->off + 1);
+		return CHAIN_PREV;
+
+	bounds_done:
+		dbglog(a->conf, "histogram: found %L bucket boundaries", h->offs.len);
+		if (!a->conf->hist_exact) {
+			if (0 != hist_print(a))
+				return CHAIN_ERR;
+			return CHAIN_FIN;
+		}
+
+		// read the whole range
+		ffvec_zallocT(&h->lines, h->offs.len, uint64);
+		h->off = *(uint64*)h->offs.ptr;
+		h->last_char = '\n';
+		ffstr_null(&a->startdate.input);
+		arlg_file_seek(a, h->off);
+		h->state = H_COUNT;
+		return CHAIN_PREV;
+
+	case H_COUNT:
+		hist_count(a, *in);
+		if (h->off < *ffslice_lastT(&h->offs, uint64)
+			&& !(a->chain_flags & CHAIN_FFIRST))
+			return CHAIN_PREV;
+
+		if (h->last_char != '\n' && h->ib + 1 < h->offs.len) {
+			// the last line without new-line character
+			((uint64*)h->lines.ptr)[h->ib]++;
+		}
+		if (0 != hist_print(a))
+			return CHAIN_ERR;
+		return CHAIN_FIN;
+	}
+	return CHAIN_ERR;
+}
+
+struct filter_if filter_hist = { "hist", hist_open, hist_close, hist_process };
@@ -0,0 +1,697 @@
+/** archeolog: content index of log file (--index)
+2022, Simon Zolin */
+
+/*
+The index file FILE.arlgidx has an entry for each complete 1MB block of the log file:
+ . bloom filter of the words of the lines that intersect the block;
+ . min/max timestamps of the lines that start in the block (zone map);
+ . offset of the first line that starts in the block.
+A word is a run of [0-9A-Za-z_] and non-ASCII bytes, at least 3 bytes long.
+
+With --filter the blocks whose bloom filter doesn't have all words of the filter text are skipped without reading.
+Only the words that are whole in the filter text are checked:
+ the ones inside the text (the first and the last ones may be a part of a longer word in the line),
+ or all of them with --word.
+A line that intersects a skipped block doesn't contain the filter text:
+ the reading continues from the first line that starts in the next block to read,
+ and the part of the line before the gap is terminated by "_\n" (a word byte and a line end):
+ the part alone can't match the filter text (see match_word()).
+
+The start-date search window is narrowed by the zone map to the block where the first line at or after start-date is.
+
+The index is built by the first query with --index and is updated by the next ones as the log file grows:
+ the blocks after the last complete one are indexed from the first line that isn't within the complete blocks.
+The incomplete line at the end of file isn't indexed: a block is complete when a line ends after it.
+The new entries are appended to the index file and then its header is rewritten,
+ so the entries that a concurrent query may read aren't modified.
+Only one query updates the index at a time: it holds flock() on FILE.arlgidx.lock,
+ which is released if the process is killed; the other queries use the old index.
+The index is rebuilt when the log file is replaced (its first bytes differ) or truncated.
+With different timestamp settings (--ts-field, --ts-offset, --json) the index isn't updated
+ and its zone map isn't used.
+
+File format (host byte order):
+	struct idx_hdr
+	(struct idx_block, bloom[IDX_BLOOM])...
+*/
+
+#ifdef FF_UNIX
+#include <sys/file.h>
+#endif
+
+#define IDX_EXT  ".arlgidx"
+#define IDX_MAGIC  "ARLGIDX1"
+#define IDX_BLOCK  (1*1024*1024) // log file block size
+#define IDX_BLOOM  (16*1024) // bloom filter size per block
+#define IDX_HASHES  4 // N of bits per word in bloom filter
+#define IDX_WORD_MIN  3 // shorter words aren't indexed
+#define IDX_LINE_WORDS  (64*1024) // max N of word hashes per line: then they're added to the line's bloom filter
+#define IDX_HEAD  4096 // N of bytes at the log file start which identify the file
+#define IDX_READ  (1*1024*1024) // read buffer size for indexing
+#define IDX_NOLINE  0xffffffff
+
+#define IDX_FNV_INIT  0xcbf29ce484222325ULL
+#define IDX_FNV_PRIME  0x100000001b3ULL
+
+struct idx_hdr {
+	char magic[8];
+	uint block_size, bloom_size;
+	uint64 nblocks; // N of complete blocks
+	uint64 resume_off; // the first line that isn't within the complete blocks
+	uint64 head_hash; // hash of the first IDX_HEAD bytes of log file
+	uint64 ts_conf; // hash of the timestamp settings
+};
+
+struct idx_block {
+	uint64 min_sec, max_sec; // timestamps of the lines that start in the block
+	uint min_nsec, max_nsec;
+	uint nts; // N of the lines with timestamp
+	uint line; // offset of the first line in the block;  IDX_NOLINE: the block is within a line
+};
+
+#define IDX_ENTRY  (sizeof(struct idx_block) + IDX_BLOOM)
+
+enum IDX_V {
+	IDX_V_UNKNOWN,
+	IDX_V_READ,
+	IDX_V_SKIP,
+};
+
+struct idx_verdict {
+	uint line; // struct idx_block.line
+	uint v; // enum IDX_V
+};
+
+struct idx_build {
+	struct archeolog *a;
+	fffd fd; // the new index file
+	uint64 nblocks; // N of written entries
+	uint64 resume_off;
+	ffvec open; // the entries of the blocks after the written ones
+	ffvec words; // uint64[]: the current line's word hashes
+	uint64 line_off; // the current line start
+	uint64 h; // the current word hash
+	uint wlen; // the current word length
+	ffbyte *line_bloom; // the current line's words (a long line)
+	char *head; // the first bytes of the current line (timestamp)
+	uint head_len, head_cap;
+	uint many_words :1; // the current line's words are in 'line_bloom'
+};
+
+static inline int idx_wordchar(uint c)
+{
+	return ((c | 0x20) - 'a' < 26 || c - '0' < 10 || c == '_' || c >= 0x80);
+}
+
+static inline uint64 idx_hash(const char *p, ffsize n)
+{
+	uint64 h = IDX_FNV_INIT;
+	for (ffsize i = 0;  i != n;  i++) {
+		h = (h ^ (ffbyte)p[i]) * IDX_FNV_PRIME;
+	}
+	return h;
+}
+
+static void idx_bloom_add(ffbyte *bloom, uint64 h)
+{
+	uint h1 = h, h2 = h >> 32;
+	for (uint i = 0;  i != IDX_HASHES;  i++) {
+		uint bit = (h1 + i * h2) & (IDX_BLOOM * 8 - 1);
+		bloom[bit / 8] |= 1 << (bit % 8);
+	}
+}
+
+static int idx_bloom_test(const ffbyte *bloom, uint64 h)
+{
+	uint h1 = h, h2 = h >> 32;
+	for (uint i = 0;  i != IDX_HASHES;  i++) {
+		uint bit = (h1 + i * h2) & (IDX_BLOOM * 8 - 1);
+		if (!(bloom[bit / 8] & (1 << (bit % 8))))
+			return 0;
+	}
+	return 1;
+}
+
+/** Compare the timestamp with 't'
+frac: compare the fractions of a second (as date_cmp() does) */
+static int idx_ts_cmp(uint64 sec, uint nsec, const fftime *t, uint frac)
+{
+	if (sec != (uint64)t->sec)
+		return (sec < (uint64)t->sec) ? -1 : 1;
+	if (!frac)
+		return 0;
+	return (nsec < t->nsec) ? -1 : (nsec > t->nsec);
+}
+
+/** Hash of the settings which affect the timestamps in the index.
+The year for syslog lines isn't included: their timestamps aren't used. */
+static uint64 idx_ts_conf(struct arlg_conf *conf)
+{
+	uint v[] = { conf->ts_fmt, ffmax(conf->ts_field, 1), conf->ts_offset }; // field 0 and 1 are the same
+	uint64 h = idx_hash((char*)v, sizeof(v));
+	return h ^ idx_hash(conf->ts_key.ptr, conf->ts_key.len);
+}
+
+/** Hash of the first bytes of log file
+Return 0 on error */
+static uint64 idx_head_hash(struct archeolog *a)
+{
+	char buf[IDX_HEAD];
+	if (IDX_HEAD != file_zero_read(a, buf, IDX_HEAD, 0))
+		return 0;
+	return idx_hash(buf, IDX_HEAD);
+}
+
+/** Get the entry of the block that isn't written yet */
+static ffbyte* idx_open_entry(struct idx_build *b, uint64 i)
+{
+	return (ffbyte*)b->open.ptr + (i - b->nblocks) * IDX_ENTRY;
+}
+
+/** Write the complete entries to file
+Return 0 on success */
+static int idx_write(struct idx_build *b, uint64 nblocks)
+{
+	ffsize n = (nblocks - b->nblocks) * IDX_ENTRY;
+	if ((ffssize)n != fffile_writeat(b->fd, b->open.ptr, n, sizeof(struct idx_hdr) + b->nblocks * IDX_ENTRY)) {
+		infolog(b->a->conf, "index: file write: %E", fferr_last());
+		return -1;
+	}
+	ffmem_move(b->open.ptr, (char*)b->open.ptr + n, b->open.len - n);
+	b->open.len -= n;
+	b->nblocks = nblocks;
+	return 0;
+}
+
+/** Add the line [line_off..end) to the entries of its blocks
+Return 0 on success */
+static int idx_line_end(struct idx_build *b, uint64 end)
+{
+	struct arlg_conf *conf = b->a->conf;
+	uint64 first = ffmax(b->line_off / IDX_BLOCK, b->nblocks), last = (end - 1) / IDX_BLOCK;
+
+	if (last >= first) {
+		ffsize n = (last - b->nblocks + 1) * IDX_ENTRY;
+		if (n > b->open.len) {
+			if (NULL == ffvec_grow(&b->open, n - b->open.len, 1)) {
+				errlog(conf, "no memory");
+				return -1;
+			}
+			for (uint64 i = b->nblocks + b->open.len / IDX_ENTRY;  i <= last;  i++) {
+				ffbyte *e = (ffbyte*)b->open.ptr + b->open.len;
+				ffmem_zero(e, IDX_ENTRY);
+				((struct idx_block*)e)->line = IDX_NOLINE;
+				b->open.len += IDX_ENTRY;
+			}
+		}
+
+		for (uint64 i = first;  i <= last;  i++) {
+			ffbyte *bloom = idx_open_entry(b, i) + sizeof(struct idx_block);
+			if (b->many_words) {
+				for (uint k = 0;  k != IDX_BLOOM;  k++) {
+					bloom[k] |= b->line_bloom[k];
+				}
+				continue;
+			}
+			const uint64 *w;
+			FFSLICE_WALK(&b->words, w) {
+				idx_bloom_add(bloom, *w);
+			}
+		}
+	}
+
+	if (b->line_off / IDX_BLOCK >= b->nblocks) {
+		// the line starts in this block
+		struct idx_block *ib = (struct idx_block*)idx_open_entry(b, b->line_off / IDX_BLOCK);
+		if (ib->line == IDX_NOLINE)
+			ib->line = b->line_off % IDX_BLOCK;
+
+		ffstr s = FFSTR_INITN(b->head, b->head_len);
+		ffssize k = ffstr_findchar(&s, '\n');
+		if (k >= 0)
+			s.len = k;
+		fftime t;
+		if (conf->ts_fmt != TSF_NONE
+			&& date_parse_exact(conf, &s, &t) > 0) {
+			if (ib->nts == 0 || idx_ts_cmp(ib->min_sec, ib->min_nsec, &t, 1) > 0) {
+				ib->min_sec = t.sec;
+				ib->min_nsec = t.nsec;
+			}
+			if (ib->nts == 0 || idx_ts_cmp(ib->max_sec, ib->max_nsec, &t, 1) < 0) {
+				ib->max_sec = t.sec;
+				ib->max_nsec = t.nsec;
+			}
+			ib->nts++;
+		}
+	}
+
+	uint64 complete = end / IDX_BLOCK;
+	if (complete > b->nblocks) {
+		if (0 != idx_write(b, complete))
+			return -1;
+		b->resume_off = (end > complete * IDX_BLOCK) ? b->line_off : end;
+	}
+
+	b->line_off = end;
+	b->head_len = 0;
+	b->words.len = 0;
+	if (b->many_words) {
+		ffmem_zero(b->line_bloom, IDX_BLOOM);
+		b->many_words = 0;
+	}
+	return 0;
+}
+
+/** Add the current word to the line's words
+Return 0 on success */
+static int idx_word_end(struct idx_build *b)
+{
+	if (b->wlen < IDX_WORD_MIN)
+		goto end;
+
+	if (!b->many_words && b->words.len == IDX_LINE_WORDS) {
+		if (b->line_bloom == NULL
+			&& NULL == (b->line_bloom = ffmem_calloc(1, IDX_BLOOM))) {
+			errlog(b->a->conf, "no memory");
+			return -1;
+		}
+		const uint64 *w;
+		FFSLICE_WALK(&b->words, w) {
+			idx_bloom_add(b->line_bloom, *w);
+		}
+		b->words.len = 0;
+		b->many_words = 1;
+	}
+	if (b->many_words)
+		idx_bloom_add(b->line_bloom, b->h);
+	else
+		*ffvec_pushT(&b->words, uint64) = b->h;
+
+end:
+	b->h = IDX_FNV_INIT;
+	b->wlen = 0;
+	return 0;
+}
+
+/** Index the log file data at offset 'off'
+Return 0 on success */
+static int idx_data(struct idx_build *b, const char *d, ffsize n, uint64 off)
+{
+	for (ffsize i = 0;  i != n;  i++) {
+		uint c = (ffbyte)d[i];
+		if (b->head_len != b->head_cap)
+			b->head[b->head_len++] = c;
+		if (idx_wordchar(c)) {
+			b->h = (b->h ^ c) * IDX_FNV_PRIME;
+			b->wlen++;
+			continue;
+		}
+		if (b->wlen != 0
+			&& 0 != idx_word_end(b))
+			return -1;
+		if (c == '\n'
+			&& 0 != idx_line_end(b, off + i + 1))
+			return -1;
+	}
+	return 0;
+}
+
+/** Index the log file from 'resume_off' to the end of data
+Return 0 on success */
+static int idx_build(struct idx_build *b)
+{
+	struct archeolog *a = b->a;
+	uint64 off = b->resume_off, end = a->file.data_end;
+	int rc = -1;
+	char *buf = ffmem_alloc(IDX_READ);
+	b->head_cap = ffmax(a->conf->date_len, 1);
+	b->head = ffmem_alloc(b->head_cap);
+	if (buf == NULL || b->head == NULL) {
+		errlog(a->conf, "no memory");
+		goto end;
+	}
+	b->line_off = off;
+	b->h = IDX_FNV_INIT;
+
+	while (off < end) {
+		int r = file_zero_read(a, buf, ffmin(IDX_READ, end - off), off);
+		if (r <= 0) {
+			errlog(a->conf, "file read: %E", fferr_last());
+			goto end;
+		}
+		if (0 != idx_data(b, buf, r, off))
+			goto end;
+		off += r;
+	}
+	rc = 0;
+
+end:
+	ffmem_free(buf);
+	ffmem_free(b->head);
+	ffmem_free(b->line_bloom);
+	ffvec_free(&b->open);
+	ffvec_free(&b->words);
+	return rc;
+}
+
+/** Check that the index belongs to the log file
+The file may be longer than the header says: the entries of an interrupted update are overwritten by the next one.
+Return 0 on success */
+static int idx_check(struct archeolog *a, fffd fd, struct idx_hdr *h)
+{
+	if (sizeof(*h) != fffile_readat(fd, h, sizeof(*h), 0)
+		|| ffmem_cmp(h->magic, IDX_MAGIC, 8)
+		|| h->block_size != IDX_BLOCK
+		|| h->bloom_size != IDX_BLOOM)
+		return -1;
+	if (fffile_size(fd) < (int64)(sizeof(*h) + h->nblocks * IDX_ENTRY)
+		|| h->resume_off > a->file.size
+		|| h->nblocks * IDX_BLOCK > a->file.size
+		|| h->head_hash != idx_head_hash(a))
+		return -1;
+	return 0;
+}
+
+/** Lock the index for update: the lock is released when the process exits
+Return the lock file descriptor;  FFFILE_NULL: another query is updating the index, or error */
+static fffd idx_lock(struct archeolog *a, const char *lock)
+{
+#ifdef FF_UNIX
+	fffd lf = fffile_open(lock, FFFILE_CREATE | FFFILE_WRITEONLY);
+	if (lf != FFFILE_NULL
+		&& 0 != flock(lf, LOCK_EX | LOCK_NB)) {
+		fffile_close(lf);
+		lf = FFFILE_NULL;
+	}
+#else
+	fffd lf = fffile_open(lock, FFFILE_CREATENEW | FFFILE_WRITEONLY);
+#endif
+	if (lf == FFFILE_NULL)
+		infolog(a->conf, "index: lock: %s: %E: the index isn't updated", lock, fferr_last());
+	return lf;
+}
+
+static void idx_unlock(const char *lock, fffd lf)
+{
+	fffile_close(lf);
+#ifndef FF_UNIX
+	fffile_remove(lock);
+#endif
+}
+
+/** Index the new complete blocks of log file.
+The entries are appended to a valid index in place, otherwise a new index replaces the old file.
+h: [in] the old index header (zeroed if there's no valid index)
+ [out] the new one
+Return 0: the index file is updated;  1: no new blocks;  -1: error */
+static int idx_update(struct archeolog *a, const char *fn, struct idx_hdr *h)
+{
+	int rc = -1;
+	struct idx_build b = {};
+	char *tmp = NULL, *lock = ffsz_allocfmt("%s.lock", fn);
+	fffd lf = idx_lock(a, lock);
+	if (lf == FFFILE_NULL) {
+		ffmem_free(lock);
+		return -1;
+	}
+
+	// another query may have updated the index before the lock
+	b.fd = fffile_open(fn, FFFILE_READWRITE);
+	if (b.fd != FFFILE_NULL
+		&& 0 != idx_check(a, b.fd, h)) {
+		fffile_close(b.fd);
+		b.fd = FFFILE_NULL;
+		ffmem_zero_obj(h);
+	}
+	if (h->nblocks != 0 && h->ts_conf != idx_ts_conf(a->conf)) {
+		rc = 1;
+		goto end;
+	}
+	if (b.fd == FFFILE_NULL) {
+		// a file left by a killed update is overwritten: the lock is held
+		tmp = ffsz_allocfmt("%s.tmp", fn);
+		b.fd = fffile_open(tmp, FFFILE_CREATE | FFFILE_TRUNCATE | FFFILE_WRITEONLY);
+		if (b.fd == FFFILE_NULL) {
+			infolog(a->conf, "index: file create: %s: %E", tmp, fferr_last());
+			ffmem_free(tmp);
+			tmp = NULL;
+			goto end;
+		}
+	}
+	b.a = a;
+	b.nblocks = h->nblocks;
+	b.resume_off = h->resume_off;
+
+	if (0 != idx_build(&b))
+		goto end;
+	if (b.nblocks == h->nblocks) {
+		rc = 1;
+		goto end;
+	}
+	dbglog(a->conf, "index: indexed blocks %U..%U", h->nblocks, b.nblocks);
+
+	if (h->nblocks == 0) {
+		ffmem_copy(h->magic, IDX_MAGIC, 8);
+		h->block_size = IDX_BLOCK;
+		h->bloom_size = IDX_BLOOM;
+		h->head_hash = idx_head_hash(a);
+		h->ts_conf = idx_ts_conf(a->conf);
+	}
+	h->nblocks = b.nblocks;
+	h->resume_off = b.resume_off;
+	if (sizeof(*h) != fffile_writeat(b.fd, h, sizeof(*h), 0)) {
+		infolog(a->conf, "index: file write: %E", fferr_last());
+		goto end;
+	}
+	fffile_close(b.fd);
+	b.fd = FFFILE_NULL;
+	if (tmp != NULL
+		&& 0 != fffile_rename(tmp, fn)) {
+		infolog(a->conf, "index: file rename: %s: %E", fn, fferr_last());
+		goto end;
+	}
+	rc = 0;
+
+end:
+	if (b.fd != FFFILE_NULL)
+		fffile_close(b.fd);
+	if (rc != 0 && tmp != NULL)
+		fffile_remove(tmp);
+	ffmem_free(tmp);
+	idx_unlock(lock, lf);
+	ffmem_free(lock);
+	return rc;
+}
+
+/** Get the hashes of the filter words */
+static void idx_filter_words(struct archeolog *a)
+{
+	struct arlg_index *x = &a->index;
+	ffstr s = a->conf->filter;
+	for (ffsize i = 0;  i != s.len;  ) {
+		if (!idx_wordchar((ffbyte)s.ptr[i])) {
+			i++;
+			continue;
+		}
+		ffsize j = i;
+		while (j != s.len && idx_wordchar((ffbyte)s.ptr[j])) {
+			j++;
+		}
+		uint whole = (a->conf->filter_word || (i != 0 && j != s.len));
+		if (whole && j - i >= IDX_WORD_MIN)
+			*ffvec_pushT(&x->words, uint64) = idx_hash(s.ptr + i, j - i);
+		i = j;
+	}
+}
+
+/** Build or update the index and open it.
+The query continues without the index if it can't be used. */
+static void index_open(struct archeolog *a)
+{
+	struct arlg_index *x = &a->index;
+	struct arlg_conf *conf = a->conf;
+	struct idx_hdr h = {};
+	char *fn = ffsz_allocfmt("%s%s", conf->filename, IDX_EXT);
+
+	x->fd = fffile_open(fn, FFFILE_READONLY);
+	if (x->fd != FFFILE_NULL
+		&& 0 != idx_check(a, x->fd, &h)) {
+		dbglog(conf, "index: %s: doesn't match the file: rebuilding", fn);
+		fffile_close(x->fd);
+		x->fd = FFFILE_NULL;
+		ffmem_zero_obj(&h);
+	}
+
+	// the blocks indexed with other timestamp settings are used only for skipping
+	uint ts_same = (h.nblocks == 0 || h.ts_conf == idx_ts_conf(conf));
+
+	// a new block may be complete
+	if (ts_same
+		&& a->file.data_end >= (h.nblocks + 1) * IDX_BLOCK
+		&& 0 == idx_update(a, fn, &h)) {
+		if (x->fd != FFFILE_NULL)
+			fffile_close(x->fd);
+		x->fd = fffile_open(fn, FFFILE_READONLY);
+	}
+	if (x->fd == FFFILE_NULL)
+		goto end;
+
+	x->nblocks = h.nblocks;
+	x->resume_off = h.resume_off;
+	x->ts = (ts_same && conf->ts_fmt != TSF_NONE && conf->ts_fmt != TSF_SYSLOG);
+	if (conf->filter.len != 0
+		&& !conf->records
+		&& conf->hist_interval == 0 && conf->sample == 0 && !conf->explain
+		&& conf->chain.len == 0 && a->plugin_filters.len == 0) {
+		// the data before 'match' filter isn't modified
+		idx_filter_words(a);
+		x->skip = (x->words.len != 0 && x->nblocks != 0);
+	}
+	if (x->skip
+		&& (NULL == ffvec_zallocT(&x->verdicts, x->nblocks, struct idx_verdict)
+			|| NULL == (x->entry = ffmem_alloc(IDX_ENTRY)))) {
+		errlog(conf, "no memory");
+		x->skip = 0;
+	}
+	dbglog(conf, "index: %s: %U blocks, resume @%U, skip:%u  zone map:%u"
+		, fn, x->nblocks, x->resume_off, x->skip, x->ts);
+
+end:
+	ffmem_free(fn);
+}
+
+static void index_close(struct archeolog *a)
+{
+	struct arlg_index *x = &a->index;
+	if (x->skip)
+		dbglog(a->conf, "index: skipped %U of %U blocks", x->skipped, x->nblocks);
+	if (x->fd != FFFILE_NULL)
+		fffile_close(x->fd);
+	ffvec_free(&x->words);
+	ffvec_free(&x->verdicts);
+	ffmem_free(x->entry);
+}
+
+/** Find the first block with timestamps within [i..end)
+ (the blocks within a long line or with the lines without timestamp don't have them)
+Return block index;  'end': not found;  -1: error */
+static int64 idx_ts_next(struct archeolog *a, uint64 i, uint64 end, struct idx_block *ib)
+{
+	for (;  i < end;  i++) {
+		if (sizeof(*ib) != fffile_readat(a->index.fd, ib, sizeof(*ib), sizeof(struct idx_hdr) + i * IDX_ENTRY))
+			return -1;
+		if (ib->nts != 0)
+			break;
+	}
+	return i;
+}
+
+/** Check whether the block must be read: its bloom filter has all filter words,
+ or it's after end-date (the next filters stop at its first line)
+Return 1: read;  0: skip;  -1: error (skipping is disabled) */
+static int index_block(struct archeolog *a, uint64 i)
+{
+	struct arlg_index *x = &a->index;
+	struct idx_verdict *vd = (struct idx_verdict*)x->verdicts.ptr + i;
+	if (vd->v != IDX_V_UNKNOWN)
+		return (vd->v == IDX_V_READ);
+
+	if (IDX_ENTRY != fffile_readat(x->fd, x->entry, IDX_ENTRY, sizeof(struct idx_hdr) + i * IDX_ENTRY)) {
+		infolog(a->conf, "index: file read: %E", fferr_last());
+		x->skip = 0;
+		return -1;
+	}
+	const struct idx_block *ib = (void*)x->entry;
+	const ffbyte *bloom = x->entry + sizeof(struct idx_block);
+	vd->v = IDX_V_READ;
+	vd->line = ib->line;
+	if (x->ts && a->conf->end_date.sec != 0 && ib->nts != 0
+		&& idx_ts_cmp(ib->min_sec, ib->min_nsec, &a->conf->end_date, a->conf->ts_frac) > 0)
+		return 1;
+
+	const uint64 *w;
+	FFSLICE_WALK(&x->words, w) {
+		if (!idx_bloom_test(bloom, *w)) {
+			vd->v = IDX_V_SKIP;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/** Get the offset to read from: skip the blocks without the filter words.
+end: [out] the offset to read until
+Return offset */
+static uint64 index_next(struct archeolog *a, uint64 off, uint64 *end)
+{
+	struct arlg_index *x = &a->index;
+	uint64 i = off / IDX_BLOCK, d = off;
+	int r;
+	*end = (uint64)-1;
+	if (i >= x->nblocks)
+		return off;
+
+	if (0 == (r = index_block(a, i))) {
+		// continue from the first line that starts in a block to read:
+		//  the lines that intersect the skipped blocks don't contain the filter text
+		const struct idx_verdict *vd = x->verdicts.ptr;
+		uint64 i0 = i;
+		for (i++;  i < x->nblocks;  i++) {
+			if (0 != (r = index_block(a, i))
+				&& !(r > 0 && vd[i].line == IDX_NOLINE))
+				break;
+		}
+		if (r < 0)
+			return off;
+		d = (i != x->nblocks) ? i * IDX_BLOCK + vd[i].line : ffmax(off, x->resume_off);
+		if (d != off)
+			x->skipped += i - i0;
+		if (i == x->nblocks)
+			return d;
+	}
+	if (r < 0)
+		return off;
+
+	// read until the next block to skip
+	uint64 e = i + 1, lim = i + 1 + a->conf->read_chunk_size_large / IDX_BLOCK;
+	while (e < x->nblocks && e < lim && 0 < (r = index_block(a, e))) {
+		e++;
+	}
+	if (e < x->nblocks && r == 0)
+		*end = e * IDX_BLOCK;
+	return d;
+}
+
+/** Narrow the start-date search window by the zone map:
+ find the first block with a line at or after start-date */
+static void index_window(struct archeolog *a, uint64 *start_off, uint64 *jump_end)
+{
+	struct arlg_index *x = &a->index;
+	struct idx_block ib;
+	if (!a->conf->index || x->fd == FFFILE_NULL || !x->ts
+		|| a->conf->start_date.sec == 0)
+		return;
+
+	// the first block whose next block with timestamps has the max. timestamp at or after start-date
+	uint64 lo = *start_off / IDX_BLOCK, hi = x->nblocks;
+	int64 i;
+	while (lo < hi) {
+		uint64 mid = lo + (hi - lo) / 2;
+		if (0 > (i = idx_ts_next(a, mid, hi, &ib)))
+			return;
+		if ((uint64)i < hi
+			&& idx_ts_cmp(ib.max_sec, ib.max_nsec, &a->conf->start_date, a->conf->ts_frac) < 0)
+			lo = i + 1;
+		else
+			hi = mid;
+	}
+	if (0 > (i = idx_ts_next(a, lo, x->nblocks, &ib)))
+		return;
+
+	// the line at the block start is found from the previous byte
+	if (i != 0)
+		*start_off = ffmax(*start_off, (uint64)i * IDX_BLOCK - 1);
+	if ((uint64)i < x->nblocks)
+		*jump_end = ffmin(*jump_end, (uint64)(i + 1) * IDX_BLOCK);
+	dbglog(a->conf, "index: start-date window: %U..%U", *start_off, *jump_end);
+}
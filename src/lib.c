@@ -0,0 +1,74 @@
+/** archeolog: library interface
+2022, Simon Zolin */
+
+#include <archeolog.h>
+#include <proc.h>
+#include <FFOS/std.h>
+#include <FFOS/ffos-extern.h>
+
+void arlg_log(struct arlg_conf *conf, uint level, const char *fmt, ...)
+{
+	static const char prefix[][8] = {
+		"ERR:\t",
+		"INFO:\t",
+		"DBG:\t",
+		"",
+	};
+	char buf[4096];
+	ffstr s = {};
+	s.ptr = buf;
+	ffstr_addfmt(&s, sizeof(buf), "%s", prefix[level]);
+	ffsize n = s.len;
+
+	va_list args;
+	va_start(args, fmt);
+	ffstr_addfmtv(&s, sizeof(buf) - 1, fmt, args);
+	va_end(args);
+
+	if (conf->log != NULL) {
+		conf->log(conf->udata, level, s.ptr + n, s.len - n);
+		return;
+	}
+	s.ptr[s.len++] = '\n';
+	ffstderr_write(s.ptr, s.len);
+}
+
+struct archeolog* arlg_create(struct arlg_conf *conf)
+{
+	struct archeolog *a;
+	if (NULL == (a = ffmem_new(struct archeolog)))
+		return NULL;
+	if (0 != arlg_open(a, conf)) {
+		arlg_free(a);
+		return NULL;
+	}
+	return a;
+}
+
+void arlg_free(struct archeolog *a)
+{
+	if (a == NULL)
+		return;
+	arlg_close(a);
+	ffmem_free(a);
+}
+
+int arlg_file_newest(struct arlg_conf *conf, fftime *t)
+{
+	int rc = -1;
+	struct archeolog *a;
+	if (NULL == (a = arlg_create(conf)))
+		return -1;
+	if (CHAIN_NEXT == file_open(a)) {
+		*t = a->file.newest;
+		rc = 0;
+	}
+	file_close(a);
+	arlg_free(a);
+	return rc;
+}
+
+void arlg_cancel(struct archeolog *a)
+{
+	__atomic_store_n(&a->cancel, 1, __ATOMIC_RELEASE);
+}
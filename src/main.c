@@ -2,34 +2,27 @@
 2022, Simon Zolin */
 
 #include <archeolog.h>
-#include <proc.h>
-#include <FFOS/std.h>
-#include <FFOS/ffos-extern.h>
-
-void log_print(int level, const char *fmt, ...)
-{
-	char buf[4096];
-	ffstr s = {};
-	s.ptr = buf;
-	va_list args;
-	va_start(args, fmt);
-	ffsize r = ffstr_addfmtv(&s, sizeof(buf), fmt, args);
-	va_end(args);
-	if (r != 0)
-		r = ffstderr_write(s.ptr, r);
-}
 
 int main(int argc, const char **argv)
 {
 	int rc = 1;
 	struct archeolog *a = NULL;
-	gconf = ffmem_new(struct arlg_conf);
-	if (0 != conf_cmdline(gconf, argc, argv)) {
+	struct arlg_conf conf = {};
+	if (0 != conf_cmdline(&conf, argc, argv)) {
+		goto end;
+	}
+
+	if (conf.serve != NULL) {
+		rc = serve(&conf);
+		goto end;
+	}
+
+	if (conf.inputs.len != 0) {
+		rc = arlg_merge(&conf);
 		goto end;
 	}
 
-	a = ffmem_new(struct archeolog);
-	if (0 != arlg_open(a, gconf))
+	if (NULL == (a = arlg_create(&conf)))
 		goto end;
 	if (0 != arlg_extract(a))
 		goto end;
@@ -37,7 +30,7 @@ int main(int argc, const char **argv)
 	rc = 0;
 
 end:
-	arlg_close(a);
-	conf_destroy(gconf);
+	arlg_free(a);
+	conf_destroy(&conf);
 	return rc;
 }
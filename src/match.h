@@ -0,0 +1,216 @@
+/** archeolog: pass only the records that contain the filter text
+2022, Simon Zolin */
+
+/*
+A record is a line, or (--records) a stamped line along with its continuation lines.
+The matching records that follow each other are passed as one block without copying.
+Only a record that is split between input blocks is copied to the carry buffer.
+*/
+
+#include <util/simd.h>
+
+int match_open(struct archeolog *a)
+{
+	struct arlg_match *m = &a->match;
+	if (a->conf->filter.len == 0)
+		return CHAIN_DONE;
+	if (a->conf->records)
+		ts_lead(a->conf, &m->lead_lo, &m->lead_hi);
+	return CHAIN_READY;
+}
+
+void match_close(struct archeolog *a)
+{
+	ffvec_free(&a->match.carry);
+}
+
+/** Find the start of the next record
+off: [in] search position
+ [out] position to continue the search from after more data is appended
+last: no more data will be appended
+Return offset;  -1: need more data */
+static ffssize match_next(struct archeolog *a, const char *p, ffsize n, ffsize *off, uint last)
+{
+	struct arlg_match *m = &a->match;
+	ffsize i = *off;
+	ffssize r;
+	fftime t;
+
+	if (!a->conf->records) {
+		if (0 > (r = ffs_findchar(p + i, n - i, '\n'))) {
+			*off = n;
+			return -1;
+		}
+		return i + r + 1;
+	}
+
+	for (;;) {
+		// skip quickly the lines that can't start with a timestamp
+		if (0 > (r = ffsimd_findnl_range(p + i, n - i, m->lead_lo, m->lead_hi))) {
+			*off = (n != 0) ? ffmax(i, n - 1) : 0;
+			return -1;
+		}
+		i += r;
+
+		ffstr line = FFSTR_INITN(p + i + 1, n - i - 1);
+		if (0 < (r = date_parse(a->conf, &line, &t)))
+			return i + 1;
+		if (r < 0 && !last) {
+			*off = i;
+			return -1;
+		}
+		i++; // continuation line
+	}
+}
+
+/** Complete the record in carry buffer with the data from the next block
+Return 1: record is complete;  0: need more data */
+static int match_carry(struct archeolog *a)
+{
+	struct arlg_match *m = &a->match;
+	ffsize n = m->carry.len, off;
+	ffssize r;
+
+	if (a->conf->records) {
+		// the lines at the end of carry buffer may need some bytes from the new block
+		ffsize k = ffmin(m->in.len, a->conf->date_len + 1);
+		ffvec_add(&m->carry, m->in.ptr, k, 1);
+		r = match_next(a, m->carry.ptr, m->carry.len, &m->scan, (m->last && k == m->in.len));
+		if (r >= 0) {
+			if ((ffsize)r <= n) {
+				// the next record starts within carry buffer
+				m->carry.len = n;
+			} else {
+				m->carry.len = r;
+				ffstr_shift(&m->in, r - n);
+			}
+			m->rec_len = r;
+			return 1;
+		}
+		if (k == m->in.len && !m->last) {
+			ffstr_shift(&m->in, k);
+			return 0;
+		}
+		m->carry.len = n;
+	}
+
+	off = 0;
+	if (0 > (r = match_next(a, m->in.ptr, m->in.len, &off, m->last))) {
+		if (!m->last) {
+			ffvec_add(&m->carry, m->in.ptr, m->in.len, 1);
+			ffstr_shift(&m->in, m->in.len);
+			m->scan = n + off;
+			return 0;
+		}
+		r = m->in.len;
+	}
+	ffvec_add(&m->carry, m->in.ptr, r, 1);
+	ffstr_shift(&m->in, r);
+	m->rec_len = m->carry.len;
+	return 1;
+}
+
+/** Find the filter text that isn't a part of a longer word (--word):
+ the bytes around it (within the record) must not be word bytes (as the index defines them) */
+static int match_word(struct archeolog *a, const char *p, ffsize n)
+{
+	const ffstr *flt = &a->conf->filter;
+	for (ffsize i = 0;  ;  i++) {
+		ffssize r = ffs_findstr(p + i, n - i, flt->ptr, flt->len);
+		if (r < 0)
+			return 0;
+		i += r;
+		ffsize e = i + flt->len;
+		if (!(i != 0 && idx_wordchar((ffbyte)p[i - 1]))
+			&& !(e != n && idx_wordchar((ffbyte)p[e])))
+			return 1;
+	}
+}
+
+static int match_rec(struct archeolog *a, const char *p, ffsize n)
+{
+	if (a->conf->filter_word)
+		return match_word(a, p, n);
+	return 0 <= ffs_findstr(p, n, a->conf->filter.ptr, a->conf->filter.len);
+}
+
+static int match_ret(struct archeolog *a)
+{
+	struct arlg_match *m = &a->match;
+	if (m->last && m->in.len == 0 && m->carry.len == m->rec_len)
+		return CHAIN_SPLIT;
+	return CHAIN_NEXT;
+}
+
+/** Return enum CHAIN_R */
+int match_process(struct archeolog *a, ffstr *in, ffstr *out)
+{
+	struct arlg_match *m = &a->match;
+	ffsize off = 0, pos = 0;
+	ffssize r;
+
+	if (!(a->chain_flags & CHAIN_FBACK)) {
+		m->in = *in;
+		m->last = !!(a->chain_flags & CHAIN_FFIRST);
+	}
+
+	for (;;) {
+		if (m->rec_len != 0) {
+			// remove the record that was passed or skipped
+			ffmem_move(m->carry.ptr, (char*)m->carry.ptr + m->rec_len, m->carry.len - m->rec_len);
+			m->carry.len -= m->rec_len;
+			m->rec_len = 0;
+			m->scan = 0;
+		}
+		if (m->carry.len == 0)
+			break;
+
+		if (!match_carry(a))
+			return CHAIN_PREV;
+		if (match_rec(a, m->carry.ptr, m->rec_len)) {
+			ffstr_set(out, m->carry.ptr, m->rec_len);
+			return match_ret(a);
+		}
+	}
+
+	for (;;) {
+		if (off == m->in.len)
+			break;
+
+		pos = off;
+		if (0 > (r = match_next(a, m->in.ptr, m->in.len, &pos, m->last))) {
+			if (!m->last)
+				break;
+			r = m->in.len;
+		}
+
+		if (match_rec(a, m->in.ptr + off, r - off)) {
+			off = r;
+			continue;
+		}
+
+		if (off != 0) {
+			ffstr_set(out, m->in.ptr, off);
+			ffstr_shift(&m->in, r); // and skip this record
+			return match_ret(a);
+		}
+		ffstr_shift(&m->in, r);
+	}
+
+	if (off != 0) {
+		ffstr_set(out, m->in.ptr, off);
+		ffstr_shift(&m->in, off);
+		return match_ret(a);
+	}
+
+	if (m->last)
+		return CHAIN_SPLIT;
+
+	// store the incomplete record
+	ffvec_add(&m->carry, m->in.ptr, m->in.len, 1);
+	ffstr_shift(&m->in, m->in.len);
+	m->scan = pos;
+	return CHAIN_PREV;
+}
+
+struct filter_if filter_match = { "match", match_open, match_close, match_process };
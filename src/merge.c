@@ -0,0 +1,318 @@
+/** archeolog: merge the lines from several files in timestamp order
+2022, Simon Zolin */
+
+/*
+Each file is processed by its own processor instance (start-date search, filters)
+ which is suspended after each output, so the data is read only as needed:
+
+processor #1 -> buf -> record --\
+processor #2 -> buf -> record ----> min-heap -> output
+...                             /
+
+The data from processor is split into records: a stamped line with the following lines without timestamp.
+The timestamp of each line is parsed once: the line that ends a record is the first line of the next one.
+The heap contains the files which have the current record;
+ the file with the earliest record is at the top (the earlier file on equal timestamps).
+
+The relative dates are set from the newest timestamp among all files,
+ so the lines from each file are within the same time range.
+*/
+
+#include <archeolog.h>
+#include <FFOS/std.h>
+#include <ffbase/vector.h>
+
+#define MERGE_OUT_BUF  (64*1024)
+#define MERGE_TS_DETECT  (64*1024)
+
+struct merge;
+
+struct merge_src {
+	struct merge *m;
+	uint idx;
+	struct arlg_conf conf;
+	struct archeolog *a;
+	ffvec buf; // data from processor
+	ffsize off; // the current record's offset in buffer
+	ffsize rec_len; // the current record's length;  0: no record
+	ffsize scan; // the current record's length checked so far
+	fftime key; // the current record's timestamp
+	fftime next_key; // timestamp of the line that ends the current record
+	uint done :1 // processor has finished
+		, next_key_valid :1
+		, ts_checked :1;
+};
+
+struct merge {
+	struct arlg_conf *conf;
+	struct merge_src *srcs;
+	uint nsrcs;
+	struct merge_src **heap;
+	uint nheap;
+	ffvec out;
+};
+
+/** Forward log messages to the user's configuration */
+static void merge_src_log(void *udata, uint level, const char *msg, ffsize len)
+{
+	struct merge_src *s = udata;
+	if (level == ARLG_LOG_STATS) {
+		arlg_log(s->m->conf, level, "%*s", len, msg); // JSON object already has the file name
+		return;
+	}
+	arlg_log(s->m->conf, level, "%s: %*s", s->conf.filename, len, msg);
+}
+
+static int merge_src_output(void *udata, const char *data, ffsize len)
+{
+	struct merge_src *s = udata;
+	if (len != ffvec_add(&s->buf, data, len, 1))
+		return -1;
+	return 0;
+}
+
+static void merge_src_close(struct merge_src *s)
+{
+	arlg_free(s->a);
+	if (s->conf.ts_key.ptr != s->m->conf->ts_key.ptr)
+		ffstr_free(&s->conf.ts_key); // set by timestamp format detection
+	ffvec_free(&s->buf);
+}
+
+/** Return 1 if the complete line starts with timestamp */
+static int merge_line_stamped(struct merge_src *s, ffstr line, fftime *t)
+{
+	return (date_parse_exact(&s->conf, &line, t) > 0);
+}
+
+/** Find the end of the current record: the next stamped line
+Return record length;  0: need more data */
+static ffsize merge_rec_find(struct merge_src *s)
+{
+	ffstr d = FFSTR_INITN((char*)s->buf.ptr + s->off, s->buf.len - s->off), line;
+	fftime t;
+
+	while (s->scan != d.len) {
+		ffstr_set(&line, d.ptr + s->scan, d.len - s->scan);
+		ffssize i = ffstr_findchar(&line, '\n');
+		if (i < 0 && !s->done)
+			return 0;
+		if (i >= 0)
+			line.len = i;
+
+		if (s->scan == 0) {
+			// the first line: a line without timestamp at the file start goes with the previous key
+			if (s->next_key_valid)
+				s->key = s->next_key;
+			else if (merge_line_stamped(s, line, &t))
+				s->key = t;
+			s->next_key_valid = 0;
+		} else if (merge_line_stamped(s, line, &t)) {
+			s->next_key = t;
+			s->next_key_valid = 1;
+			return s->scan;
+		}
+		s->scan += line.len + (i >= 0);
+	}
+
+	if (s->scan != 0 && s->done)
+		return s->scan;
+	return 0;
+}
+
+/** Get the next record from processor
+Return 0 on success (rec_len=0: no more data) */
+static int merge_src_next(struct merge_src *s)
+{
+	s->off += s->rec_len;
+	s->rec_len = 0;
+	s->scan = 0;
+
+	for (;;) {
+		if (0 != (s->rec_len = merge_rec_find(s)))
+			return 0;
+		if (s->done)
+			return 0;
+
+		// move the remaining data to the buffer start
+		ffmem_move(s->buf.ptr, (char*)s->buf.ptr + s->off, s->buf.len - s->off);
+		s->buf.len -= s->off;
+		s->off = 0;
+
+		ffsize n = s->buf.len;
+		int r = arlg_extract(s->a);
+		if (r == ARLG_R_OK)
+			s->done = 1;
+		else if (r != ARLG_R_SUSPEND)
+			return -1;
+
+		if (!s->ts_checked && s->conf.ts_fmt == TSF_NONE && s->buf.len != n) {
+			// the processor didn't need timestamps: detect the format now
+			s->ts_checked = 1;
+			ts_detect(&s->conf, (char*)s->buf.ptr + n, ffmin(s->buf.len - n, MERGE_TS_DETECT));
+		}
+	}
+}
+
+/** Find the newest timestamp among all files for the relative dates
+Return 0 on success */
+static int merge_newest(struct merge *m)
+{
+	fftime newest = {}, t;
+	for (uint i = 0;  i != m->nsrcs;  i++) {
+		struct merge_src *s = &m->srcs[i];
+		struct arlg_conf c = s->conf;
+		c.index = 0;
+		c.stats = 0;
+		c.trace = NULL;
+		int r = arlg_file_newest(&c, &t);
+		if (c.ts_key.ptr != s->conf.ts_key.ptr)
+			ffstr_free(&c.ts_key); // set by timestamp format detection
+		if (r != 0)
+			return -1;
+		if (fftime_cmp(&t, &newest) > 0)
+			newest = t;
+	}
+	dbglog(m->conf, "newest timestamp in all files: %Usec", newest.sec);
+	for (uint i = 0;  i != m->nsrcs;  i++) {
+		m->srcs[i].conf.newest = newest;
+	}
+	return 0;
+}
+
+/** Return 1 if record 'a' must be output before record 'b' */
+static int merge_before(const struct merge_src *a, const struct merge_src *b)
+{
+	int r = fftime_cmp(&a->key, &b->key);
+	return (r < 0 || (r == 0 && a->idx < b->idx));
+}
+
+/** Move the element at the top down to its position */
+static void merge_heap_down(struct merge *m)
+{
+	struct merge_src **h = m->heap, *t;
+	uint i = 0;
+	for (;;) {
+		uint l = i*2 + 1, r = l + 1, min = i;
+		if (l < m->nheap && merge_before(h[l], h[min]))
+			min = l;
+		if (r < m->nheap && merge_before(h[r], h[min]))
+			min = r;
+		if (min == i)
+			break;
+		t = h[i],  h[i] = h[min],  h[min] = t;
+		i = min;
+	}
+}
+
+/** Add element */
+static void merge_heap_push(struct merge *m, struct merge_src *s)
+{
+	struct merge_src **h = m->heap, *t;
+	uint i = m->nheap++;
+	h[i] = s;
+	while (i != 0) {
+		uint parent = (i - 1) / 2;
+		if (!merge_before(h[i], h[parent]))
+			break;
+		t = h[i],  h[i] = h[parent],  h[parent] = t;
+		i = parent;
+	}
+}
+
+static int merge_flush(struct merge *m)
+{
+	if (m->out.len == 0)
+		return 0;
+
+	int r = 0;
+	if (m->conf->output != NULL) {
+		r = m->conf->output(m->conf->udata, m->out.ptr, m->out.len);
+	} else if ((ffsize)ffstdout_write(m->out.ptr, m->out.len) != m->out.len) {
+		errlog(m->conf, "write: %E", fferr_last());
+		r = -1;
+	}
+	m->out.len = 0;
+	return r;
+}
+
+static int merge_write(struct merge *m, const char *d, ffsize n)
+{
+	ffvec_add(&m->out, d, n, 1);
+	if (m->out.len >= MERGE_OUT_BUF)
+		return merge_flush(m);
+	return 0;
+}
+
+/** Output the records from the heap top until all files are finished */
+static int merge_run(struct merge *m)
+{
+	while (m->nheap != 0) {
+		struct merge_src *s = m->heap[0];
+		if (0 != merge_write(m, (char*)s->buf.ptr + s->off, s->rec_len))
+			return 1;
+
+		if (0 != merge_src_next(s))
+			return 1;
+		if (s->rec_len == 0) {
+			dbglog(m->conf, "%s: finished", s->conf.filename);
+			m->heap[0] = m->heap[--m->nheap];
+		}
+		merge_heap_down(m);
+	}
+	return merge_flush(m);
+}
+
+int arlg_merge(struct arlg_conf *conf)
+{
+	int rc = 1;
+	struct merge m = {};
+	m.conf = conf;
+	m.nsrcs = 1 + conf->inputs.len;
+	if (NULL == (m.srcs = ffmem_calloc(m.nsrcs, sizeof(struct merge_src)))
+		|| NULL == (m.heap = ffmem_alloc(m.nsrcs * sizeof(struct merge_src*)))
+		|| NULL == ffvec_alloc(&m.out, MERGE_OUT_BUF, 1)) {
+		errlog(conf, "no memory");
+		goto end;
+	}
+
+	char **names = conf->inputs.ptr;
+	for (uint i = 0;  i != m.nsrcs;  i++) {
+		struct merge_src *s = &m.srcs[i];
+		s->m = &m;
+		s->idx = i;
+		s->conf = *conf;
+		s->conf.filename = (i == 0) ? conf->filename : names[i - 1];
+		ffvec_null(&s->conf.inputs);
+		s->conf.suspend = 1;
+		s->conf.merged = 1;
+		s->conf.output = merge_src_output;
+		s->conf.log = merge_src_log;
+		s->conf.udata = s;
+	}
+
+	if (conf->dates_rel
+		&& 0 != merge_newest(&m))
+		goto end;
+
+	for (uint i = 0;  i != m.nsrcs;  i++) {
+		struct merge_src *s = &m.srcs[i];
+		if (NULL == (s->a = arlg_create(&s->conf))
+			|| 0 != merge_src_next(s))
+			goto end;
+		if (s->rec_len != 0)
+			merge_heap_push(&m, s);
+	}
+
+	rc = merge_run(&m);
+
+end:
+	for (uint i = 0;  i != m.nsrcs && m.srcs != NULL;  i++) {
+		if (m.srcs[i].m != NULL)
+			merge_src_close(&m.srcs[i]);
+	}
+	ffmem_free(m.srcs);
+	ffmem_free(m.heap);
+	ffvec_free(&m.out);
+	return rc;
+}
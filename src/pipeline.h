@@ -0,0 +1,317 @@
+/** archeolog: reader and writer threads
+2022, Simon Zolin */
+
+/*
+Sequential reading, processing by the filters and writing run in parallel:
+
+reader thread -> (full) -> main thread: filters -> (full) -> writer thread
+      ^-------- (free) <--'          `--> (free) ----------------'
+
+Each stage pops a buffer from 'full' ring, and after it has finished with the buffer,
+ returns it to 'free' ring of the stage that filled it.
+The input buffer is released when the file filter is called again:
+ at this time the next filters have processed all the data in it.
+The output data is copied into the writer's buffers:
+ it may point into the memory that the filters reuse after they return.
+*/
+
+#include <util/ring.h>
+#include <FFOS/thread.h>
+
+#define PIPE_NBUFS  4
+#define PIPE_OUT_BUF_SIZE  (1*1024*1024)
+
+static void file_data_detect(struct archeolog *a, uint64 from);
+
+/** Let the other thread work: spin shortly, then sleep */
+static void pipe_wait(uint i)
+{
+	if (i < 100)
+		ffthread_yield();
+	else
+		ffthread_sleep(1);
+}
+
+/** Wait until an item is available */
+static void* pipe_pop(ffspsc *q)
+{
+	void *p;
+	for (uint i = 0;  !ffspsc_pop(q, &p);  i++) {
+		pipe_wait(i);
+	}
+	return p;
+}
+
+/** Add an item.  The rings are larger than N of buffers, so they are never full. */
+static void pipe_push(ffspsc *q, void *p)
+{
+	int r = ffspsc_push(q, p);
+	FF_ASSERT(r);
+	(void)r;
+}
+
+static int pipe_rings_init(ffspsc *full, ffspsc *free, struct fcache *pool, uint bufsize, uint align, ffarena *arena)
+{
+	if (0 != ffspsc_alloc(full, PIPE_NBUFS * 2)
+		|| 0 != ffspsc_alloc(free, PIPE_NBUFS * 2)
+		|| 0 != fcache_init(pool, PIPE_NBUFS, bufsize, align, arena))
+		return -1;
+
+	struct fcache_buf *b;
+	FFSLICE_WALK(&pool->bufs, b) {
+		pipe_push(free, b);
+	}
+	return 0;
+}
+
+static void pipe_rings_destroy(ffspsc *full, ffspsc *free, struct fcache *pool)
+{
+	ffspsc_free(full);
+	ffspsc_free(free);
+	fcache_destroy(pool);
+}
+
+
+/** Read the file sequentially into free buffers */
+static int reader_thread(void *param)
+{
+	struct arlg_reader *rd = param;
+	uint64 off = rd->off;
+	struct fcache_buf *b;
+
+	for (;;) {
+		for (uint i = 0;  ;  i++) {
+			if (__atomic_load_n(&rd->stop, __ATOMIC_ACQUIRE))
+				return 0;
+			if (ffspsc_pop(&rd->free, (void**)&b))
+				break;
+			pipe_wait(i);
+		}
+
+		uint64 end = rd->end;
+		if (rd->skip_holes) {
+			// skip the hole;  don't read past the next hole
+			int64 d = fffile_data_next(rd->fd, off), h;
+			off = (d >= 0) ? ffmax(off, (uint64)d) : end;
+			if (off < end && 0 < (h = fffile_hole_next(rd->fd, off)))
+				end = ffmin(end, (uint64)h);
+		}
+		uint n = (off < end) ? ffmin(rd->chunk, end - off) : 0;
+		int r = (n != 0) ? fffile_readat(rd->fd, b->ptr, n, off) : 0;
+		b->off = off;
+		b->len = ffmax(r, 0);
+		if (r < 0)
+			rd->err = fferr_last();
+		else if ((uint)r < n)
+			rd->end = off + r; // the file has got smaller
+		pipe_push(&rd->full, b);
+		if (r <= 0 || off + r >= rd->end) // error or EOF
+			return 0;
+		off += r;
+	}
+}
+
+/** Start reading from offset 'off' in background */
+static int reader_start(struct archeolog *a, uint64 off)
+{
+	struct arlg_reader *rd = &a->file.reader;
+	if (rd->pool.bufs.len == 0
+		&& 0 != pipe_rings_init(&rd->full, &rd->free, &rd->pool
+			, a->conf->read_chunk_size_large, a->conf->read_chunk_align, &a->arena)) {
+		errlog(a->conf, "no memory");
+		return -1;
+	}
+
+	rd->fd = a->file.fd;
+	rd->chunk = a->conf->read_chunk_size_large;
+	rd->off = ffint_align_floor2(off, a->conf->read_chunk_align);
+	rd->next = rd->off;
+	rd->end = a->file.data_end;
+	rd->skip_holes = a->file.skip_holes;
+	rd->done = 0;
+	rd->stop = 0;
+	rd->err = 0;
+	if (FFTHREAD_NULL == (rd->th = ffthread_create(reader_thread, rd, 0))) {
+		errlog(a->conf, "thread create: %E", fferr_last());
+		return -1;
+	}
+	dbglog(a->conf, "reader: started @%U", rd->off);
+	return 0;
+}
+
+/** Stop the reader thread and return all buffers to the free ring */
+static void reader_stop(struct archeolog *a)
+{
+	struct arlg_reader *rd = &a->file.reader;
+	if (rd->th == FFTHREAD_NULL)
+		return;
+
+	__atomic_store_n(&rd->stop, 1, __ATOMIC_RELEASE);
+	ffthread_join(rd->th, -1, NULL);
+	rd->th = FFTHREAD_NULL;
+	dbglog(a->conf, "reader: stopped");
+
+	ffspsc_reset(&rd->full);
+	ffspsc_reset(&rd->free);
+	struct fcache_buf *b;
+	FFSLICE_WALK(&rd->pool.bufs, b) {
+		pipe_push(&rd->free, b);
+	}
+	rd->buf = NULL;
+}
+
+static void reader_destroy(struct archeolog *a)
+{
+	struct arlg_reader *rd = &a->file.reader;
+	reader_stop(a);
+	pipe_rings_destroy(&rd->full, &rd->free, &rd->pool);
+}
+
+/** Get the next block read by the reader thread
+Return enum CHAIN_R */
+static int reader_read(struct archeolog *a, ffstr *out)
+{
+	struct arlg_file *f = &a->file;
+	struct arlg_reader *rd = &f->reader;
+
+	if (rd->buf != NULL) {
+		// the next filters have processed the previous block
+		pipe_push(&rd->free, rd->buf);
+		rd->buf = NULL;
+	}
+
+	if (rd->th != FFTHREAD_NULL && (f->cur != rd->next || rd->done))
+		reader_stop(a); // there was a seek
+	if (rd->th == FFTHREAD_NULL
+		&& 0 != reader_start(a, f->cur))
+		return CHAIN_ERR;
+
+	fftime t;
+	if (a->conf->trace != NULL)
+		t = fftime_monotonic();
+	struct fcache_buf *b = pipe_pop(&rd->full);
+	if (a->conf->trace != NULL)
+		trace_add(a, "reader wait", "io", t, b->len, 0, NULL);
+	rd->done = (b->len == 0 || b->off + b->len >= rd->end); // the reader thread has exited
+	a->stats.reads++;
+	a->stats.read_bytes += b->len;
+	if (b->len == 0) {
+		pipe_push(&rd->free, b);
+		if (rd->err != 0) {
+			errlog(a->conf, "file read: %E", rd->err);
+			return CHAIN_ERR;
+		}
+		f->read_last = 1; // end of data
+		ffstr_null(out);
+		return CHAIN_NEXT;
+	}
+	if (!f->data_end_checked && b->ptr[b->len - 1] == '\0') {
+		// zero bytes at the end of file
+		file_data_detect(a, b->off);
+		if (f->data_end <= ffmax(f->cur, b->off)) {
+			pipe_push(&rd->free, b);
+			f->read_last = 1;
+			ffstr_null(out);
+			return CHAIN_NEXT;
+		}
+		if (b->off + b->len > f->data_end) {
+			b->len = f->data_end - b->off;
+			rd->done = 1; // don't use the blocks read after this one
+		}
+	}
+	if (b->off > f->cur)
+		dbglog(a->conf, "reader: skipped hole @%U..%U", f->cur, b->off);
+	f->cur = ffmax(f->cur, b->off);
+	rd->buf = b;
+	rd->next = b->off + b->len;
+	f->read_last = rd->done;
+	dbglog(a->conf, "reader: %L @%U(%u%%)  last:%u"
+		, b->len, b->off, (int)(b->off * 100 / f->size), f->read_last);
+
+	ffstr_setstr(out, b);
+	ffstr_shift(out, f->cur - b->off);
+	f->cur = b->off + b->len;
+	if (f->skip_holes)
+		ffstr_trim_zeros(out);
+	return CHAIN_NEXT;
+}
+
+
+/** Write the filled buffers to stdout */
+static int writer_thread(void *param)
+{
+	struct arlg_writer *w = param;
+	struct fcache_buf *b;
+
+	for (;;) {
+		if (NULL == (b = pipe_pop(&w->full)))
+			return 0;
+
+		if (w->err == 0
+			&& 0 != arlg_output(w->conf, b->ptr, b->len))
+			w->err = 1;
+		b->len = 0;
+		pipe_push(&w->free, b);
+	}
+}
+
+static int writer_start(struct archeolog *a)
+{
+	struct arlg_writer *w = &a->writer;
+	w->conf = a->conf;
+	if (0 != pipe_rings_init(&w->full, &w->free, &w->pool, PIPE_OUT_BUF_SIZE, 64, &a->arena)) {
+		errlog(a->conf, "no memory");
+		return -1;
+	}
+	if (FFTHREAD_NULL == (w->th = ffthread_create(writer_thread, w, 0))) {
+		errlog(a->conf, "thread create: %E", fferr_last());
+		return -1;
+	}
+	return 0;
+}
+
+/** Pass the remaining data to the writer thread and wait until it exits
+Return 0 if all data is written */
+static int writer_stop(struct archeolog *a)
+{
+	struct arlg_writer *w = &a->writer;
+	if (w->th == FFTHREAD_NULL)
+		return 0;
+
+	if (w->buf != NULL && w->buf->len != 0) {
+		pipe_push(&w->full, w->buf);
+		w->buf = NULL;
+	}
+	pipe_push(&w->full, NULL);
+	ffthread_join(w->th, -1, NULL);
+	w->th = FFTHREAD_NULL;
+	return w->err;
+}
+
+static void writer_destroy(struct archeolog *a)
+{
+	struct arlg_writer *w = &a->writer;
+	writer_stop(a);
+	pipe_rings_destroy(&w->full, &w->free, &w->pool);
+}
+
+/** Copy data to the writer's buffers */
+static void writer_add(struct archeolog *a, const char *d, ffsize n)
+{
+	struct arlg_writer *w = &a->writer;
+	while (n != 0) {
+		if (w->buf == NULL)
+			w->buf = pipe_pop(&w->free);
+
+		ffsize k = ffmin(n, PIPE_OUT_BUF_SIZE - w->buf->len);
+		ffmem_copy(w->buf->ptr + w->buf->len, d, k);
+		w->buf->len += k;
+		d += k;
+		n -= k;
+
+		if (w->buf->len == PIPE_OUT_BUF_SIZE) {
+			pipe_push(&w->full, w->buf);
+			w->buf = NULL;
+		}
+	}
+}
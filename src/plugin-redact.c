@@ -0,0 +1,70 @@
+/** archeolog: plugin example: replace the digits after the timestamp with '#'
+2022, Simon Zolin */
+
+/*
+Build:
+ make redact.so
+Usage:
+ archeolog --plugin=./redact.so ...
+*/
+
+#include <archeolog.h>
+#include <ffbase/vector.h>
+
+struct redact {
+	ffvec buf;
+	ffsize col; // position within the current line
+};
+
+static int redact_open(struct archeolog *a)
+{
+	const struct arlg_pub *p = (struct arlg_pub*)a;
+	if (NULL == (*p->fctx = ffmem_new(struct redact)))
+		return CHAIN_ERR;
+	return CHAIN_READY;
+}
+
+static void redact_close(struct archeolog *a)
+{
+	const struct arlg_pub *p = (struct arlg_pub*)a;
+	struct redact *rd = *p->fctx;
+	ffvec_free(&rd->buf);
+	ffmem_free(rd);
+}
+
+/** Return enum CHAIN_R */
+static int redact_process(struct archeolog *a, ffstr *in, ffstr *out)
+{
+	const struct arlg_pub *p = (struct arlg_pub*)a;
+	struct redact *rd = *p->fctx;
+	if (p->chain_flags & CHAIN_FBACK)
+		return CHAIN_PREV;
+
+	ffsize keep = p->conf->date_len;
+	rd->buf.len = 0;
+	ffvec_add2(&rd->buf, in, 1);
+
+	char *d = rd->buf.ptr;
+	for (ffsize i = 0;  i != rd->buf.len;  i++) {
+		if (d[i] == '\n') {
+			rd->col = 0;
+			continue;
+		}
+		if (rd->col++ >= keep && d[i] >= '0' && d[i] <= '9')
+			d[i] = '#';
+	}
+
+	ffstr_set2(out, &rd->buf);
+	if (p->chain_flags & CHAIN_FFIRST)
+		return CHAIN_SPLIT;
+	if (out->len == 0)
+		return CHAIN_PREV;
+	return CHAIN_NEXT;
+}
+
+static const struct filter_if filter_redact = { "redact", redact_open, redact_close, redact_process };
+
+ARLG_EXPORT const struct filter_if *arlg_plugin_filters[] = {
+	&filter_redact,
+	NULL,
+};
@@ -3,41 +3,199 @@
 
 #include "fcache.h"
 #include <util/stream.h>
+#include <util/ring.h>
+#include <util/simd.h>
+#include <util/sparse.h>
 #include <FFOS/perf.h>
 #include <FFOS/std.h>
+#include <FFOS/dylib.h>
+#include <FFOS/thread.h>
 #include <ffbase/vector.h>
+#ifdef FF_UNIX
+#include <poll.h>
+#endif
+
+struct arlg_reader {
+	ffthread th;
+	ffspsc full, free; // struct fcache_buf*[]
+	struct fcache pool;
+	struct fcache_buf *buf; // the block being processed by the filters
+	fffd fd;
+	uint chunk;
+	uint64 off; // start offset
+	uint64 next; // offset of the next block
+	uint64 end; // end of data
+	uint skip_holes;
+	uint stop; // the reader thread must exit
+	int err; // read error
+	uint done :1; // the reader thread has read the last block
+};
 
 struct arlg_file {
 	fffd fd;
 	uint64 size, cur, seek;
+	uint64 data_end; // the end of data: without the holes and zero bytes at the end of file
+	uint64 newest_off; // offset of the line with the newest timestamp (file_newest())
+	fftime newest;
 	struct fcache cache;
 	uint read_last;
 	uint read_chunk_size;
+	uint64 rand_reads, rand_read_usec; // random access reads: N and time
+	uint page_size; // 0: page cache residency isn't available
+	void *map; // the file mapped for page cache residency check
+	uint64 map_size;
+	struct arlg_reader reader;
+	uint seq :1 // sequential access
+		, sparse :1 // the file has holes
+		, skip_holes :1 // skip the holes during sequential reading
+		, data_end_checked :1;
+};
+
+struct arlg_writer {
+	struct arlg_conf *conf;
+	ffthread th;
+	ffspsc full, free; // struct fcache_buf*[]
+	struct fcache pool;
+	struct fcache_buf *buf; // the buffer being filled
+	int err; // write error
 };
 
 struct arlg_startdate {
 	uint state;
 	uint64 start_off, end_off, off_prev;
-	fftime start_date, end_date;
+	uint64 jump_off; // offset of the last jump
+	uint64 jump_end; // no lines start between this offset and end_off (except end_off)
 	uint njumps;
+	uint probe, probe_min; // block size for a jump
+	uint jump_reads; // N of additional reads after the last jump
+	uint64 gap_sum; // sum of the distances from the jump offset to the next line
+	uint ngaps;
+	uint ncached; // N of jumps moved to the cached pages
 	ffstr input;
 	ffstream stm;
+	struct date_cache dcache;
 	fftime time_start;
-	uint seq_scan :1;
+	uint64 reads_start; // N of reads before the search
+	uint seq_scan :1
+		, end_found :1
+		, skip_line :1
+		, skip_zeros :1 // a line starts after the zero bytes (the data region after a hole)
+		, eof :1
+		, eof_ok :1; // don't fail if there are no lines at or after start-date
+};
+
+struct arlg_match {
+	ffstr in;
+	ffvec carry; // the record that is split between input blocks
+	ffsize rec_len; // N of bytes of the complete record in carry buffer
+	ffsize scan; // continue searching for the record end from this position in carry buffer
+	ffbyte lead_lo, lead_hi; // range of the first character of a stamped line
+	uint last :1;
+};
+
+struct arlg_hist {
+	uint state;
+	fftime start, t, end; // the first, the current bucket boundary;  the end of the last bucket
+	ffvec offs; // uint64[]: offsets of bucket boundaries
+	ffvec lines; // uint64[]: N of lines in buckets
+	uint64 sample_size, sample_lines;
+	uint64 off; // the current offset while counting lines
+	uint ib; // the current bucket while counting lines
+	char last_char;
+};
+
+struct arlg_sample {
+	uint state;
+	uint block; // block size
+	uint64 start, end; // range offsets
+	uint64 iblock; // the current block index
+	uint acc; // selection accumulator: +sample per block, -sample_per per selected block
+	uint64 off; // offset of the requested data
+	uint64 nblocks, size, lines; // read blocks;  output bytes and lines
+	uint done :1;
+	uint joined :1; // the previous block is output up to its end: the next one continues its last line
+};
+
+struct arlg_explain {
+	uint state;
+	uint64 start, end; // range offsets
+	uint64 sample_size, sample_lines; // the data at the range boundaries
+};
+
+struct arlg_index {
+	fffd fd;
+	uint64 nblocks; // N of indexed blocks
+	uint64 resume_off; // the data after this offset isn't indexed
+	ffvec words; // uint64[]: hashes of the filter words
+	ffvec verdicts; // struct idx_verdict[]: the checked blocks
+	ffbyte *entry; // buffer for an index entry
+	uint64 skipped; // N of skipped blocks
+	uint ts :1 // the zone map is usable
+		, skip :1; // skip the blocks without the filter words
+};
+
+struct arlg_project {
+	ffstr in;
+	ffvec carry; // the line that is split between input blocks
+	ffvec iov; // ffiovec[]
+	ffvec buf; // the gathered output data for the next filter
+	uint last :1
+		, carry_sent :1
+		, gather :1; // the next filter isn't 'out': pass the data in 'out' rather than in 'out_iov'
+};
+
+/** Execution statistics (--stats) */
+struct arlg_stats {
+	uint64 reads, read_bytes, read_usec; // read syscalls (read_usec: without reader thread)
+	uint64 jumps, search_reads, search_usec; // start-date search
+	uint64 lines_passed; // lines passed on by the range filters (data, sample): not the lines checked by them
+	uint64 lines_emitted;
+	fftime start;
+};
+
+struct arlg_filter_stats {
+	const char *name;
+	uint64 calls, usec;
+};
+
+struct trace_event {
+	const char *name, *cat;
+	uint64 start, dur; // nsec
+	uint64 in, out;
+	const char *ret;
+};
+
+/** Timeline trace (--trace) */
+struct arlg_trace {
+	fftime start;
+	ffvec events; // struct trace_event[]
+	uint dropped;
 };
 
 struct filter {
 	const struct filter_if *iface;
+	void *ctx; // plugin filter's data
+	uint istat; // index in archeolog.fstats
 	uint opened :1
 		, done :1;
 };
 
 struct archeolog {
+	// struct arlg_pub:
 	struct arlg_conf *conf;
 	uint chain_flags; // enum CHAIN_FLAGS
+	void **fctx;
+
 	ffvec ffilters; // struct filter[]
+	uint ichain; // the current filter (while suspended)
+	ffstr chain_in; // input data for the current filter (while suspended)
+	uint chain_built :1
+		, suspended :1;
+	ffvec plugins; // ffdl[]
+	ffvec plugin_filters; // const struct filter_if*[]
 
 	struct arlg_file file;
+	struct arlg_index index;
 	struct arlg_startdate startdate;
 	uint64 off;
 
@@ -45,14 +203,29 @@ struct archeolog {
 	uint64 lines;
 	ffstream stm;
 	ffstr input2;
-
+	struct date_cache dcache;
+	uint block_check :1;
+
+	struct arlg_match match;
+	struct arlg_hist hist;
+	struct arlg_sample sample;
+	struct arlg_explain explain;
+	struct arlg_project project;
+	ffslice out_iov; // ffiovec[]: output data fragments (instead of input data)
 	uint64 out_total;
+	struct arlg_writer writer;
+	uint cancel; // set by another thread
+
+	struct arlg_stats stats;
+	ffvec fstats; // struct arlg_filter_stats[]: don't move when filters are removed from chain
+	struct arlg_trace trace;
+	ffarena arena; // the large buffers: released at once after the query
 };
 
 int arlg_open(struct archeolog *a, struct arlg_conf *conf)
 {
 	a->conf = conf;
-	ffstream_realloc(&a->stm, a->conf->date_len);
+	ffarena_init(&a->arena, FFARENA_HUGEPAGE, (conf->hugepages) ? FFARENA_HUGEPAGES : 0);
 	return 0;
 }
 
@@ -64,12 +237,25 @@ void arlg_close(struct archeolog *a)
 	struct filter *f;
 	FFSLICE_WALK(&a->ffilters, f) {
 		if (f->opened && f->iface->close != NULL) {
-			dbglog("filter '%s': closing", f->iface->name);
+			dbglog(a->conf, "filter '%s': closing", f->iface->name);
+			a->fctx = &f->ctx;
 			f->iface->close(a);
 		}
 	}
 	ffvec_free(&a->ffilters);
+	ffvec_free(&a->fstats);
+	ffvec_free(&a->trace.events);
+	dbglog(a->conf, "memory: %U bytes in %u chunks, %u on huge pages"
+		, a->arena.total, a->arena.nchunks, a->arena.huge_chunks);
+	ffarena_free(&a->arena);
 	ffstream_free(&a->stm);
+
+	ffdl *dl;
+	FFSLICE_WALK(&a->plugins, dl) {
+		ffdl_close(*dl);
+	}
+	ffvec_free(&a->plugins);
+	ffvec_free(&a->plugin_filters);
 }
 
 int newline_find(const ffstr *s)
@@ -80,21 +266,140 @@ int newline_find(const ffstr *s)
 	return r+1;
 }
 
+/** Check the error of a write to stdout: interrupted by signal or stdout is non-blocking.
+Return 0 if the write can be retried */
+static int stdout_retry(void)
+{
+	int e = fferr_last();
+	if (e == EINTR)
+		return 0;
+#ifdef FF_UNIX
+	if (e == EAGAIN || e == EWOULDBLOCK) {
+		struct pollfd pfd = { ffstdout, POLLOUT, 0 };
+		if (poll(&pfd, 1, -1) >= 0 || errno == EINTR)
+			return 0;
+	}
+#endif
+	return -1;
+}
+
+/** Pass data to the user's output function or to stdout
+Return 0 on success */
+static int arlg_output(struct arlg_conf *conf, const char *d, ffsize n)
+{
+	if (conf->output != NULL)
+		return conf->output(conf->udata, d, n);
+
+	while (n != 0) {
+		ffssize r = ffstdout_write(d, n);
+		if (r < 0) {
+			if (0 == stdout_retry())
+				continue;
+			errlog(conf, "write: %E", fferr_last());
+			return -1;
+		}
+		d += r;
+		n -= r;
+	}
+	return 0;
+}
+
+/** Add time since 'start' to the filter's statistics */
+static void stats_filter(struct archeolog *a, const struct filter *f, fftime start)
+{
+	struct arlg_filter_stats *fs = a->fstats.ptr;
+	fs = &fs[f->istat];
+	fftime t = fftime_monotonic();
+	fftime_sub(&t, &start);
+	fs->usec += fftime_usec(&t);
+	fs->calls++;
+}
+
+/** Add JSON string contents */
+static void json_escape_add(ffvec *buf, const char *s)
+{
+	for (;  *s != '\0';  s++) {
+		if (*s == '"' || *s == '\\')
+			ffvec_addsz(buf, "\\");
+		ffvec_add(buf, s, 1, 1);
+	}
+}
+
+/** Pass statistics to the log as JSON object */
+static void stats_print(struct archeolog *a)
+{
+	const struct arlg_stats *st = &a->stats;
+	fftime t = fftime_monotonic();
+	fftime_sub(&t, &st->start);
+
+	ffvec buf = {};
+	ffvec_addsz(&buf, "{\"file\":\"");
+	json_escape_add(&buf, a->conf->filename);
+	ffvec_addfmt(&buf, "\", \"usec\":%U"
+		", \"reads\":%U, \"read_bytes\":%U, \"read_usec\":%U"
+		", \"jumps\":%U, \"search_reads\":%U, \"search_usec\":%U"
+		", \"lines_passed\":%U, \"lines_emitted\":%U, \"output_bytes\":%U"
+		", \"filters\":["
+		, fftime_usec(&t)
+		, st->reads, st->read_bytes, st->read_usec
+		, st->jumps, st->search_reads, st->search_usec
+		, st->lines_passed, st->lines_emitted, a->out_total);
+	const struct arlg_filter_stats *fs;
+	FFSLICE_WALK(&a->fstats, fs) {
+		ffvec_addfmt(&buf, "%s{\"name\":\"%s\", \"calls\":%U, \"usec\":%U}"
+			, (fs != a->fstats.ptr) ? ", " : "", fs->name, fs->calls, fs->usec);
+	}
+	ffvec_addsz(&buf, "]}");
+	arlg_log(a->conf, ARLG_LOG_STATS, "%S", &buf);
+	ffvec_free(&buf);
+}
+
+#include "trace.h"
+#include "pipeline.h"
 #include "file.h"
+#include "index.h"
 #include "startdate.h"
 
 int dataproc_open(struct archeolog *a)
 {
-	if (a->conf->end_date.sec == 0
-		&& a->conf->max_lines == 0
-		&& a->conf->filter.len == 0) {
-		return CHAIN_DONE;
-	}
+	if (a->conf->end_date.sec == 0)
+		return CHAIN_DONE; // only end-date is checked here
+	ffstream_realloc(&a->stm, a->conf->date_len);
 	return CHAIN_READY;
 }
 
 void dataproc_close(struct archeolog *a)
 {
+	dbglog(a->conf, "data: copied %U bytes", a->stm.copied);
+}
+
+/** Check the last stamped line among the complete lines in block.
+Lines are sorted by time, so if it's within end-date, all preceding lines are too.
+Return N of bytes that can be passed without checking each line */
+static ffsize dataproc_block(struct archeolog *a, ffstr view)
+{
+	ffssize nl, i;
+	if (0 >= (nl = ffs_rfindchar(view.ptr, view.len, '\n')))
+		return 0;
+
+	ffstr line = FFSTR_INITN(view.ptr, nl);
+	for (uint n = 0;  n < 16;  n++) {
+		i = ffs_rfindchar(line.ptr, line.len, '\n');
+		ffstr ln = line;
+		ffstr_shift(&ln, i + 1);
+
+		int cmp;
+		int r = date_cmp(a->conf, &ln, DATE_END, NULL, &cmp);
+		if (r > 0) {
+			if (cmp > 0)
+				return 0; // end-date is within this block
+			return nl + 1;
+		} else if (r < 0 || i < 0) {
+			return 0;
+		}
+		line.len = i; // continuation line: check the previous one
+	}
+	return 0;
 }
 
 /** Return data until we pass end-time.
@@ -121,8 +426,11 @@ int dataproc_process(struct archeolog *a, ffstr *in, ffstr *out)
 	for (;;) {
 		switch (a->state) {
 		case I_FIRST:
-			if (in->len == 0)
+			if (in->len == 0) {
+				if (a->chain_flags & CHAIN_FFIRST)
+					return CHAIN_DONE; // no lines at or after start-date
 				return CHAIN_PREV;
+			}
 			a->state = I_GATHER,  a->nxstate = I_CHECK;
 			continue;
 
@@ -130,6 +438,8 @@ int dataproc_process(struct archeolog *a, ffstr *in, ffstr *out)
 			r = ffstream_gather_ref(&a->stm, a->input2, a->conf->date_len, &buf);
 			ffstr_shift(&a->input2, r);
 			a->off += r;
+			if (r != 0)
+				a->block_check = 1;
 			if (buf.len < a->conf->date_len) {
 				if (a->stm.ref.len != 0)
 					continue; // store input data in buffer
@@ -145,7 +455,7 @@ int dataproc_process(struct archeolog *a, ffstr *in, ffstr *out)
 				ffstr_shift(&view, view.len);
 				a->state = I_GATHER,  a->nxstate = I_FINDLINE;
 				if (view.ptr == buf.ptr) {
-					if (a->file.read_last)
+					if (a->file.read_last && a->input2.len == 0)
 						goto done;
 					continue; // nothing to output
 				}
@@ -156,13 +466,27 @@ int dataproc_process(struct archeolog *a, ffstr *in, ffstr *out)
 			continue;
 
 		case I_CHECK:
+			if (a->conf->end_date.sec != 0 && a->block_check) {
+				// the first line in a new block: try to pass the whole block at once
+				a->block_check = 0;
+				ffsize n = dataproc_block(a, view);
+				if (n != 0) {
+					dbglog(a->conf, "block: passing %L bytes", n);
+					ffstr_shift(&view, n);
+				}
+			}
+
 			if (a->conf->end_date.sec != 0) {
 				// check timestamp for the current line
-				fftime curdate;
-				r = date_parse(a->conf, &view, &curdate);
+				int cmp;
+				r = date_cmp(a->conf, &view, DATE_END, &a->dcache, &cmp);
 				if (r < 0) {
-					if (a->file.read_last)
-						goto done;
+					if (a->file.read_last && a->input2.len == 0) {
+						// the data up to the end of file is shorter than timestamp field:
+						//  the current line doesn't have a timestamp; check the next lines
+						a->state = I_FINDLINE;
+						continue;
+					}
 					a->state = I_GATHER,  a->nxstate = I_CHECK;
 					if (view.ptr == buf.ptr)
 						continue; // nothing to output
@@ -173,8 +497,8 @@ int dataproc_process(struct archeolog *a, ffstr *in, ffstr *out)
 				}
 
 				line_off = a->off - buf.len + view.ptr - buf.ptr;
-				dbglog("current: %*s @%U", (ffsize)r, view.ptr, line_off);
-				if (fftime_cmp(&curdate, &a->conf->end_date) > 0) {
+				dbglog(a->conf, "current: %*s @%U", (ffsize)r, view.ptr, line_off);
+				if (cmp > 0) {
 					goto done;
 				}
 			}
@@ -187,33 +511,317 @@ int dataproc_process(struct archeolog *a, ffstr *in, ffstr *out)
 next:
 	ffstr_set(out, buf.ptr, view.ptr - buf.ptr);
 	ffstream_consume(&a->stm, out->len);
+	if (a->conf->stats)
+		a->stats.lines_passed += ffsimd_count(out->ptr, out->len, '\n');
 	return CHAIN_NEXT;
 
 done:
 	ffstr_set(out, buf.ptr, view.ptr - buf.ptr);
+	if (a->conf->stats)
+		a->stats.lines_passed += ffsimd_count(out->ptr, out->len, '\n');
 	return CHAIN_SPLIT;
 }
 
 struct filter_if filter_data = { "data", dataproc_open, dataproc_close, dataproc_process };
 
-int out_handle(struct archeolog *a, ffstr *in, ffstr *out)
+#include "match.h"
+#include "hist.h"
+#include "sample.h"
+#include "explain.h"
+#include "project.h"
+
+/** Return 0 on success */
+static int out_writev(struct archeolog *a)
+{
+	ffiovec *iov = a->out_iov.ptr;
+	ffsize n = a->out_iov.len;
+	a->out_iov.len = 0;
+
+	if (a->conf->output != NULL) {
+		for (ffsize i = 0;  i != n;  i++) {
+			if (0 != arlg_output(a->conf, iov[i].iov_base, iov[i].iov_len))
+				return -1;
+			a->out_total += iov[i].iov_len;
+		}
+		return 0;
+	}
+
+	while (n != 0) {
+		uint k = ffmin(n, PROJ_IOV_MAX);
+		ffssize r = fffile_writev(ffstdout, iov, k);
+		if (r < 0) {
+			if (0 == stdout_retry())
+				continue;
+			errlog(a->conf, "write: %E", fferr_last());
+			return -1;
+		}
+		a->out_total += r;
+
+		// skip the written buffers;  continue from the middle of a partially written one
+		while (n != 0 && (ffsize)r >= iov->iov_len) {
+			r -= iov->iov_len;
+			iov++;
+			n--;
+		}
+		if (r != 0) {
+			iov->iov_base = (char*)iov->iov_base + r;
+			iov->iov_len -= r;
+		}
+	}
+	return 0;
+}
+
+int out_open(struct archeolog *a)
+{
+	if (a->conf->threads && !a->conf->suspend
+		&& 0 != writer_start(a))
+		return CHAIN_ERR;
+	return CHAIN_READY;
+}
+
+void out_close(struct archeolog *a)
 {
-	ffstdout_write(in->ptr, in->len);
+	writer_destroy(a);
+}
+
+/** Pass the output data to the writer thread */
+static void out_copy(struct archeolog *a, const ffstr *in)
+{
+	if (a->out_iov.len != 0) {
+		const ffiovec *iov;
+		FFSLICE_WALK(&a->out_iov, iov) {
+			writer_add(a, iov->iov_base, iov->iov_len);
+			a->out_total += iov->iov_len;
+		}
+		a->out_iov.len = 0;
+		return;
+	}
+	writer_add(a, in->ptr, in->len);
 	a->out_total += in->len;
+}
+
+/** Count the output lines */
+static void out_stats(struct archeolog *a, const ffstr *in)
+{
+	if (a->out_iov.len == 0) {
+		a->stats.lines_emitted += ffsimd_count(in->ptr, in->len, '\n');
+		return;
+	}
+	const ffiovec *iov;
+	FFSLICE_WALK(&a->out_iov, iov) {
+		a->stats.lines_emitted += ffsimd_count(iov->iov_base, iov->iov_len, '\n');
+	}
+}
+
+int out_handle(struct archeolog *a, ffstr *in, ffstr *out)
+{
+	if (a->conf->stats)
+		out_stats(a, in);
+
+	fftime t;
+	uint64 total = a->out_total;
+	if (a->conf->trace != NULL)
+		t = fftime_monotonic();
+
+	if (a->writer.th != FFTHREAD_NULL) {
+		out_copy(a, in);
+	} else if (a->out_iov.len != 0) {
+		if (0 != out_writev(a))
+			return CHAIN_ERR;
+	} else {
+		if (0 != arlg_output(a->conf, in->ptr, in->len))
+			return CHAIN_ERR;
+		a->out_total += in->len;
+	}
+
+	if (a->conf->trace != NULL)
+		trace_add(a, (a->writer.th != FFTHREAD_NULL) ? "writer queue" : "write", "output", t
+			, a->out_total - total, 0, NULL);
+
 	if (a->chain_flags & CHAIN_FFIRST) {
-		dbglog("output:%U", a->out_total);
+		dbglog(a->conf, "output:%U", a->out_total);
+		if (a->conf->trace != NULL)
+			t = fftime_monotonic();
+		int r = writer_stop(a);
+		if (a->conf->trace != NULL && a->conf->threads)
+			trace_add(a, "writer wait", "output", t, 0, 0, NULL);
+		if (r != 0)
+			return CHAIN_ERR;
 		return CHAIN_FIN;
 	}
+	a->suspended = a->conf->suspend;
 	return CHAIN_PREV;
 }
 
-struct filter_if filter_out = { "out", NULL, NULL, out_handle };
+struct filter_if filter_out = { "out", out_open, out_close, out_handle };
+
+/** Built-in filters */
+static const struct filter_if* const arlg_filters[] = {
+	&filter_file,
+	&filter_startdate,
+	&filter_data,
+	&filter_match,
+	&filter_project,
+	&filter_sample,
+	&filter_hist,
+	&filter_explain,
+	&filter_out,
+};
+
+/** Find built-in or plugin filter by name */
+static const struct filter_if* arlg_filter_find(struct archeolog *a, ffstr name)
+{
+	for (uint i = 0;  i != FF_COUNT(arlg_filters);  i++) {
+		if (ffstr_eqz(&name, arlg_filters[i]->name))
+			return arlg_filters[i];
+	}
+	const struct filter_if **it;
+	FFSLICE_WALK(&a->plugin_filters, it) {
+		if (ffstr_eqz(&name, (*it)->name))
+			return *it;
+	}
+	return NULL;
+}
+
+/** Load the filters from shared objects */
+static int arlg_plugins_load(struct archeolog *a)
+{
+	char **fn;
+	FFSLICE_WALK(&a->conf->plugins, fn) {
+		ffdl dl = ffdl_open(*fn, 0);
+		if (dl == FFDL_NULL) {
+			errlog(a->conf, "plugin: %s: %s", *fn, ffdl_errstr());
+			return 1;
+		}
+		*ffvec_pushT(&a->plugins, ffdl) = dl;
+
+		const struct filter_if **ff = ffdl_addr(dl, ARLG_PLUGIN_FILTERS);
+		if (ff == NULL) {
+			errlog(a->conf, "plugin: %s: %s", *fn, ffdl_errstr());
+			return 1;
+		}
+		for (;  *ff != NULL;  ff++) {
+			dbglog(a->conf, "plugin: %s: filter '%s'", *fn, (*ff)->name);
+			*ffvec_pushT(&a->plugin_filters, const struct filter_if*) = *ff;
+		}
+	}
+	return 0;
+}
+
+static void arlg_chain_add(struct archeolog *a, const struct filter_if *fi)
+{
+	struct filter *f = ffvec_zpushT(&a->ffilters, struct filter);
+	f->iface = fi;
+	f->istat = a->fstats.len;
+	struct arlg_filter_stats *fs = ffvec_zpushT(&a->fstats, struct arlg_filter_stats);
+	fs->name = fi->name;
+}
+
+/** Set the filters from the user's list;
+ or use the default chain and insert plugin filters after the range filters */
+static int arlg_chain_build(struct archeolog *a)
+{
+	const struct filter_if *fi;
+	ffstr s = a->conf->chain, name;
+
+	if (s.len != 0) {
+		while (s.len != 0) {
+			ffstr_splitby(&s, ',', &name, &s);
+			if (NULL == (fi = arlg_filter_find(a, name))) {
+				errlog(a->conf, "chain: unknown filter '%S'", &name);
+				return 1;
+			}
+			arlg_chain_add(a, fi);
+		}
+		const struct filter *ff = a->ffilters.ptr;
+		if (ff[0].iface != &filter_file) {
+			errlog(a->conf, "chain: the first filter must be 'file'");
+			return 1;
+		}
+		fi = ff[a->ffilters.len - 1].iface;
+		for (uint i = 0;  i != FF_COUNT(arlg_filters);  i++) {
+			if (fi == arlg_filters[i] && fi != &filter_out && fi != &filter_hist && fi != &filter_explain) {
+				// a plugin filter may be the last one
+				errlog(a->conf, "chain: the last filter must be 'out', 'hist' or 'explain'");
+				return 1;
+			}
+		}
+		// only 'out' reads the data fragments from 'out_iov'
+		for (ffsize i = 0;  i + 1 < a->ffilters.len;  i++) {
+			if (ff[i].iface == &filter_project && ff[i + 1].iface != &filter_out)
+				a->project.gather = 1;
+		}
+		return 0;
+	}
+
+	// NULL: plugin filters
+	static const struct filter_if* filters[] = {
+		&filter_file,
+		&filter_startdate,
+		&filter_data,
+		NULL,
+		&filter_match,
+		&filter_project,
+		&filter_out,
+	};
+	static const struct filter_if* hist_filters[] = {
+		&filter_file,
+		&filter_startdate,
+		&filter_hist,
+	};
+	static const struct filter_if* sample_filters[] = {
+		&filter_file,
+		&filter_startdate,
+		&filter_sample,
+		NULL,
+		&filter_match,
+		&filter_project,
+		&filter_out,
+	};
+	static const struct filter_if* explain_filters[] = {
+		&filter_file,
+		&filter_startdate,
+		&filter_explain,
+	};
+	static const struct filter_if* explain_interp_filters[] = {
+		&filter_file,
+		&filter_explain,
+	};
+	const struct filter_if **ff = filters;
+	uint nf = FF_COUNT(filters);
+	if (a->conf->explain_interp) {
+		ff = explain_interp_filters;
+		nf = FF_COUNT(explain_interp_filters);
+	} else if (a->conf->explain) {
+		ff = explain_filters;
+		nf = FF_COUNT(explain_filters);
+	} else if (a->conf->hist_interval != 0) {
+		ff = hist_filters;
+		nf = FF_COUNT(hist_filters);
+	} else if (a->conf->sample != 0) {
+		ff = sample_filters;
+		nf = FF_COUNT(sample_filters);
+	}
+
+	for (uint i = 0;  i != nf;  i++) {
+		if (ff[i] != NULL) {
+			arlg_chain_add(a, ff[i]);
+			continue;
+		}
+		const struct filter_if **it;
+		FFSLICE_WALK(&a->plugin_filters, it) {
+			arlg_chain_add(a, *it);
+		}
+	}
+	return 0;
+}
 
 int arlg_extract(struct archeolog *a)
 {
-	int rc = 1, r;
-	ffstr in = {}, out;
-	int i = 0;
+	int rc = ARLG_R_ERR, r;
+	ffstr in = a->chain_in, out;
+	int i = a->ichain;
+	struct filter *f;
 
 	// enum CHAIN_R
 	static const char ret_str[][12] = {
@@ -226,31 +834,52 @@ int arlg_extract(struct archeolog *a)
 		"CHAIN_READY",
 	};
 
-	static const struct filter_if* filters[] = {
-		&filter_file,
-		&filter_startdate,
-		&filter_data,
-		&filter_out,
-	};
-	ffvec_zallocT(&a->ffilters, FF_COUNT(filters), struct filter);
-	a->ffilters.len = FF_COUNT(filters);
-	struct filter *f;
-	FFSLICE_WALK(&a->ffilters, f) {
-		f->iface = filters[i++];
+	uint timing = (a->conf->stats || a->conf->trace != NULL);
+
+	if (!a->chain_built) {
+		if (a->conf->stats)
+			a->stats.start = fftime_monotonic();
+		if (a->conf->trace != NULL)
+			a->trace.start = fftime_monotonic();
+		if (0 != arlg_plugins_load(a)
+			|| 0 != arlg_chain_build(a))
+			return ARLG_R_ERR;
+		a->chain_built = 1;
+		a->chain_flags |= CHAIN_FFIRST;
 	}
 
-	i = 0;
-	a->chain_flags |= CHAIN_FFIRST;
 	for (;;) {
 
 		f = a->ffilters.ptr;
 		f = &f[i];
+		a->fctx = &f->ctx;
+
+		if (__atomic_load_n(&a->cancel, __ATOMIC_ACQUIRE)) {
+			dbglog(a->conf, "cancelled");
+			rc = ARLG_R_CANCEL;
+			goto end;
+		}
+
+		if (a->suspended) {
+			// continue from this filter on the next call
+			a->suspended = 0;
+			a->ichain = i;
+			a->chain_in = in;
+			return ARLG_R_SUSPEND;
+		}
 
 		if (!f->opened) {
 			f->opened = 1;
 			if (f->iface->open != NULL) {
-				dbglog("filter '%s': opening", f->iface->name);
+				dbglog(a->conf, "filter '%s': opening", f->iface->name);
+				fftime t;
+				if (timing)
+					t = fftime_monotonic();
 				r = f->iface->open(a);
+				if (a->conf->stats)
+					stats_filter(a, f, t);
+				if (a->conf->trace != NULL)
+					trace_add(a, f->iface->name, "open", t, 0, 0, ret_str[r]);
 				switch (r) {
 				case CHAIN_DONE:
 				case CHAIN_NEXT:
@@ -267,22 +896,29 @@ int arlg_extract(struct archeolog *a)
 
 		if (!f->done) {
 			ffstr_null(&out);
-			dbglog("filter '%s': %s calling in:%L  first:%u"
+			dbglog(a->conf, "filter '%s': %s calling in:%L  first:%u"
 				, f->iface->name
 				, !(a->chain_flags & CHAIN_FBACK) ? ">>" : "<<"
 				, in.len, !!(a->chain_flags & CHAIN_FFIRST));
+			fftime t;
+			if (timing)
+				t = fftime_monotonic();
 			r = f->iface->process(a, &in, &out);
-			dbglog("filter '%s' returned %s out:%L", f->iface->name, ret_str[r], out.len);
+			if (a->conf->stats)
+				stats_filter(a, f, t);
+			if (a->conf->trace != NULL)
+				trace_add(a, f->iface->name, "filter", t, in.len, out.len, ret_str[r]);
+			dbglog(a->conf, "filter '%s' returned %s out:%L", f->iface->name, ret_str[r], out.len);
 		} else {
 			// Last time the filter had returned CHAIN_DONE,
 			//  and now we're going backward
 			//  - it's time to actually close it and remove from chain.
 			FF_ASSERT(a->chain_flags & CHAIN_FBACK);
 			if (f->iface->close != NULL) {
-				dbglog("filter '%s': closing", f->iface->name);
+				dbglog(a->conf, "filter '%s': closing", f->iface->name);
 				f->iface->close(a);
 			}
-			dbglog("filter '%s': removing", f->iface->name);
+			dbglog(a->conf, "filter '%s': removing", f->iface->name);
 			ffslice_rmT((ffslice*)&a->ffilters, i, 1, struct filter);
 			if (i > 0)
 				i--;
@@ -326,7 +962,7 @@ chk_ret:
 			break;
 
 		case CHAIN_FIN:
-			rc = 0;
+			rc = ARLG_R_OK;
 			goto end;
 		case CHAIN_ERR:
 			goto end;
@@ -336,5 +972,9 @@ chk_ret:
 	}
 
 end:
+	if (a->conf->stats)
+		stats_print(a);
+	if (a->conf->trace != NULL)
+		trace_write(a);
 	return rc;
 }
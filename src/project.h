@@ -0,0 +1,218 @@
+/** archeolog: output only the selected fields or columns of each line
+2022, Simon Zolin */
+
+/*
+The selected parts of lines are passed to output as iovecs pointing into input data.
+The adjacent parts are merged into one iovec.
+Only a line that is split between input blocks is copied.
+When another filter follows, the selected parts are gathered into a buffer which is passed as output data.
+*/
+
+/** Max N of iovecs passed at once */
+#define PROJ_IOV_MAX  1024
+
+int project_open(struct archeolog *a)
+{
+	struct arlg_project *p = &a->project;
+	if (a->conf->proj.len == 0)
+		return CHAIN_DONE;
+	if (NULL == ffvec_allocT(&p->iov, PROJ_IOV_MAX, ffiovec))
+		return CHAIN_ERR;
+	return CHAIN_READY;
+}
+
+void project_close(struct archeolog *a)
+{
+	struct arlg_project *p = &a->project;
+	ffvec_free(&p->carry);
+	ffvec_free(&p->iov);
+	ffvec_free(&p->buf);
+}
+
+static void project_add(struct arlg_project *p, const char *d, ffsize n)
+{
+	if (n == 0)
+		return;
+	if (p->iov.len != 0) {
+		ffiovec *v = ffslice_lastT(&p->iov, ffiovec);
+		if ((char*)v->iov_base + v->iov_len == d) {
+			v->iov_len += n;
+			return;
+		}
+	}
+	ffiovec *v = ffvec_pushT(&p->iov, ffiovec);
+	ffiovec_set(v, d, n);
+}
+
+/** Add new-line character: from input data, if it's there */
+static void project_nl(struct archeolog *a, const char *d, ffsize n, ffsize e)
+{
+	static const char nl[] = "\n";
+	if (e != n)
+		project_add(&a->project, d + e, 1);
+	else
+		project_add(&a->project, nl, 1);
+}
+
+/** Add the selected fields of complete lines.
+A line without delimiter is passed as is.
+Return N of processed bytes */
+static ffsize project_fields(struct archeolog *a, const char *d, ffsize n, uint last)
+{
+	struct arlg_project *p = &a->project;
+	const struct arlg_range *r = a->conf->proj.ptr;
+	uint nr = a->conf->proj.len, f = 1, ir = 0, nout = 0;
+	char delim = a->conf->delim;
+	ffsize i = 0, ls = 0, fs = 0, e; // position;  line start;  field start;  field end
+	ffsize niov = 0, last_len = 0; // iovecs state at line start
+	ffssize k;
+
+	for (;;) {
+		if (i == ls) {
+			if (ls == n || p->iov.len >= PROJ_IOV_MAX)
+				break;
+			niov = p->iov.len;
+			if (niov != 0)
+				last_len = ffslice_lastT(&p->iov, ffiovec)->iov_len;
+		}
+
+		if (ir != nr)
+			k = ffsimd_findany2(d + i, n - i, delim, '\n');
+		else
+			k = ffs_findchar(d + i, n - i, '\n'); // no more fields to output
+		if (k < 0 && !last) {
+			// incomplete line: remove its fields
+			p->iov.len = niov;
+			if (niov != 0)
+				ffslice_lastT(&p->iov, ffiovec)->iov_len = last_len;
+			break;
+		}
+		e = (k >= 0) ? i + k : n;
+
+		if (e != n && d[e] == delim) {
+			if (ir != nr && f >= r[ir].lo) {
+				if (nout++ != 0)
+					project_add(p, d + fs - 1, 1);
+				project_add(p, d + fs, e - fs);
+				if (f == r[ir].hi)
+					ir++;
+			}
+			f++;
+			i = fs = e + 1;
+			continue;
+		}
+
+		if (f == 1) {
+			project_add(p, d + ls, e - ls);
+		} else if (ir != nr && f >= r[ir].lo) {
+			if (nout != 0)
+				project_add(p, d + fs - 1, 1);
+			project_add(p, d + fs, e - fs);
+		}
+		project_nl(a, d, n, e);
+
+		i = ls = fs = ffmin(e + 1, n);
+		f = 1,  ir = 0,  nout = 0;
+	}
+	return ls;
+}
+
+/** Add the selected columns of complete lines.
+Return N of processed bytes */
+static ffsize project_columns(struct archeolog *a, const char *d, ffsize n, uint last)
+{
+	struct arlg_project *p = &a->project;
+	const struct arlg_range *r = a->conf->proj.ptr;
+	uint nr = a->conf->proj.len;
+	ffsize ls = 0, len;
+	ffssize k;
+
+	while (ls != n && p->iov.len < PROJ_IOV_MAX) {
+		if (0 > (k = ffs_findchar(d + ls, n - ls, '\n'))) {
+			if (!last)
+				break; // incomplete line
+			k = n - ls;
+		}
+		len = k;
+
+		for (uint ir = 0;  ir != nr && r[ir].lo - 1 < len;  ir++) {
+			ffsize hi = ffmin(r[ir].hi, len);
+			project_add(p, d + ls + r[ir].lo - 1, hi - (r[ir].lo - 1));
+		}
+		project_nl(a, d, n, ls + len);
+		ls = ffmin(ls + len + 1, n);
+	}
+	return ls;
+}
+
+static ffsize project_lines(struct archeolog *a, const char *d, ffsize n, uint last)
+{
+	if (a->conf->proj_columns)
+		return project_columns(a, d, n, last);
+	return project_fields(a, d, n, last);
+}
+
+/** Return enum CHAIN_R */
+int project_process(struct archeolog *a, ffstr *in, ffstr *out)
+{
+	struct arlg_project *p = &a->project;
+	ffssize r;
+	ffsize n;
+
+	if (!(a->chain_flags & CHAIN_FBACK)) {
+		p->in = *in;
+		p->last = !!(a->chain_flags & CHAIN_FFIRST);
+	}
+	if (p->carry_sent) {
+		p->carry.len = 0;
+		p->carry_sent = 0;
+	}
+	p->iov.len = 0;
+
+	if (p->carry.len != 0) {
+		// complete the line in carry buffer
+		r = ffstr_findchar(&p->in, '\n');
+		if (r < 0 && !p->last) {
+			ffvec_add2(&p->carry, &p->in, 1);
+			ffstr_shift(&p->in, p->in.len);
+			return CHAIN_PREV;
+		}
+		n = (r >= 0) ? (ffsize)r + 1 : p->in.len;
+		ffvec_add(&p->carry, p->in.ptr, n, 1);
+		ffstr_shift(&p->in, n);
+		project_lines(a, p->carry.ptr, p->carry.len, 1);
+		p->carry_sent = 1; // carry buffer is referenced by output data
+	}
+
+	n = project_lines(a, p->in.ptr, p->in.len, p->last);
+	ffstr_shift(&p->in, n);
+
+	if (p->in.len != 0 && p->iov.len < PROJ_IOV_MAX && !p->carry_sent) {
+		// store the incomplete line
+		ffvec_add2(&p->carry, &p->in, 1);
+		ffstr_shift(&p->in, p->in.len);
+	}
+
+	if (p->iov.len == 0) {
+		if (p->last)
+			return CHAIN_SPLIT;
+		return CHAIN_PREV;
+	}
+
+	if (p->gather) {
+		const ffiovec *v;
+		p->buf.len = 0;
+		FFSLICE_WALK(&p->iov, v) {
+			ffvec_add(&p->buf, v->iov_base, v->iov_len, 1);
+		}
+		ffstr_set2(out, &p->buf);
+	} else {
+		ffslice_set2(&a->out_iov, &p->iov);
+		ffstr_null(out);
+	}
+	if (p->last && p->in.len == 0)
+		return CHAIN_SPLIT;
+	return CHAIN_NEXT;
+}
+
+struct filter_if filter_project = { "project", project_open, project_close, project_process };
@@ -0,0 +1,135 @@
+/** archeolog: output the lines from a subset of blocks within the range
+2022, Simon Zolin */
+
+/*
+After the start and end offsets are found, only a part of the aligned blocks is read:
+ the blocks are selected by an accumulator, e.g. 30% reads 3 blocks of every 10.
+The complete lines from these blocks are passed to the next filters.
+*/
+
+int sample_open(struct archeolog *a)
+{
+	struct arlg_sample *sm = &a->sample;
+	if (a->conf->sample == 0) {
+		errlog(a->conf, "sample: rate isn't specified");
+		return CHAIN_ERR;
+	}
+	sm->block = a->conf->read_chunk_size_small;
+	return CHAIN_READY;
+}
+
+/** Request the next block */
+static int sample_next(struct archeolog *a)
+{
+	struct arlg_sample *sm = &a->sample;
+	uint64 off = ffmax(sm->iblock * sm->block, sm->start);
+	if (off >= sm->end)
+		return 0;
+	arlg_file_behaviour(a, FBEH_RANDOM);
+	arlg_file_seek(a, off);
+	sm->off = off;
+	sm->nblocks++;
+	return 1;
+}
+
+static void sample_report(struct archeolog *a)
+{
+	struct arlg_sample *sm = &a->sample;
+	uint64 size = sm->end - sm->start, lines = 0;
+	if (sm->size != 0)
+		lines = size * sm->lines / sm->size;
+	infolog(a->conf, "sample: range: %U bytes (~%U lines) @%U..%U  read: %U blocks, %U lines"
+		, size, lines, sm->start, sm->end, sm->nblocks, sm->lines);
+}
+
+void sample_close(struct archeolog *a)
+{
+	if (a->sample.done)
+		sample_report(a);
+}
+
+/** Return enum CHAIN_R */
+int sample_process(struct archeolog *a, ffstr *in, ffstr *out)
+{
+	struct arlg_sample *sm = &a->sample;
+	enum { S_START, S_END, S_READ, S_NEXT };
+	fftime d = {}, t;
+	ffssize r;
+
+	switch (sm->state) {
+	case S_START:
+		sm->start = sm->end = a->off;
+
+		// search for the first line after end-date
+		a->conf->start_date = a->conf->end_date;
+		if (a->conf->ts_frac)
+			d.nsec = 1;
+		else
+			d.sec = 1;
+		fftime_add(&a->conf->start_date, &d);
+		a->conf->lex.len = 0;
+
+		if (in->len == 0
+			|| (date_parse(a->conf, in, &t) > 0 && fftime_cmp(&t, &a->conf->start_date) >= 0))
+			break; // the range is empty
+
+		startdate_restart(a, sm->start + 1);
+		sm->state = S_END;
+		return CHAIN_PREV;
+
+	case S_END:
+		sm->end = a->off;
+		ffstr_null(&a->startdate.input);
+		sm->iblock = sm->start / sm->block;
+		sm->state = S_NEXT;
+		return CHAIN_PREV;
+
+	case S_NEXT:
+		if (!sample_next(a))
+			break;
+		sm->state = S_READ;
+		return CHAIN_PREV;
+
+	case S_READ: {
+		if (in->len == 0)
+			return CHAIN_PREV;
+		// the data from cache may be larger than the block
+		uint64 end = ffmin((sm->off / sm->block + 1) * sm->block, sm->end);
+		ffsize n = ffmin(in->len, end - sm->off);
+		ffstr_set(out, in->ptr, n);
+
+		// the next selected block
+		uint k = (a->conf->sample_per - sm->acc + a->conf->sample - 1) / a->conf->sample;
+		sm->acc += k * a->conf->sample - a->conf->sample_per;
+		sm->iblock += k;
+
+		if (sm->off != sm->start && !sm->joined) {
+			// skip the incomplete line at block start
+			if (0 > (r = ffstr_findchar(out, '\n')))
+				r = out->len - 1;
+			ffstr_shift(out, r + 1);
+		}
+		// the adjacent blocks are output as one
+		sm->joined = (k == 1 && sm->off + n == end);
+		if (sm->off + n < sm->end && !sm->joined) {
+			// skip the incomplete line at block end
+			r = ffs_rfindchar(out->ptr, out->len, '\n');
+			out->len = r + 1;
+		}
+		sm->size += out->len;
+		uint64 nl = ffsimd_count(out->ptr, out->len, '\n');
+		sm->lines += nl;
+		a->stats.lines_passed += nl;
+
+		sm->state = S_NEXT;
+		if (sm->iblock * sm->block >= sm->end)
+			break;
+		return CHAIN_NEXT;
+	}
+	}
+
+	sm->done = 1;
+	return CHAIN_SPLIT;
+}
+
+struct filter_if filter_sample = { "sample", sample_open, sample_close, sample_process };
@@ -0,0 +1,545 @@
+/** archeolog: query server on Unix socket
+2022, Simon Zolin */
+
+/*
+Protocol:
+ the client sends the command-line arguments separated by TAB and terminated by LF, e.g.
+  "-s\t2022-06-26 08:00:00\t-e\t2022-06-26 09:00:00\t/var/log/app.log\n";
+ the server sends the output data (and the log messages as "ERR:\t...\n" lines)
+  and closes the connection.
+
+Each query is processed by its own thread with its own processor instance:
+ file reading is blocking.
+The opened files and the small blocks read by the start-date search are shared between the queries:
+ the searches over the same file mostly read the same blocks.
+A file is reopened when its path points to a different file (log rotation).
+The cached blocks of a file are dropped when the file gets smaller or its first bytes change
+ (truncated and written again, e.g. by logrotate's copytruncate).
+N of open files and the size of cached blocks are limited:
+ the least recently used files are closed when no query uses them,
+ or only their blocks are dropped.
+
+Only the files within the allowed directories (--allow) are opened:
+ the path is resolved by realpath() (symbolic links, "..") before the check.
+The socket file is created with the configured mode (=0600).
+*/
+
+#include <archeolog.h>
+#include <FFOS/thread.h>
+#include <FFOS/std.h>
+#include <ffbase/vector.h>
+
+#ifdef FF_UNIX
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <signal.h>
+
+#define SRV_MAX_QUERIES  64
+#define SRV_REQ_MAX  (64*1024)
+#define SRV_BLOCKS  1024 // N of cached blocks per file
+#define SRV_FILES_MAX  128 // max N of open files (may be exceeded by the files in use)
+#define SRV_CACHE_MAX  (256*1024*1024) // max N of bytes in cached blocks
+#define SRV_HEAD  4096 // N of bytes at the file start which identify its content
+
+struct srv_block {
+	uint64 off;
+	uint len;
+	char *data;
+};
+
+struct srv_file {
+	char *name;
+	fffd fd;
+	dev_t dev;
+	ino_t ino;
+	uint64 size; // file size at the last open
+	uint64 used; // the time of the last use (server clock)
+	uint64 cached; // N of bytes in blocks
+	char head[SRV_HEAD]; // the first bytes of file at the last open
+	uint head_len;
+	uint refs;
+	uint stale :1; // the path points to another file: close when not used
+	struct srv_block *blocks; // [SRV_BLOCKS]: direct-mapped by offset
+};
+
+struct server {
+	struct arlg_conf *conf;
+	pthread_mutex_t lock; // protects 'files' and their blocks
+	ffvec files; // struct srv_file*[]
+	uint64 clock; // incremented on each use of a file
+	uint64 cached; // N of bytes in blocks of all files
+	ffvec allow; // char*[]: the allowed directories (resolved paths)
+	uint queries; // N of active queries
+};
+
+struct srv_query {
+	struct server *srv;
+	int sk;
+};
+
+static void srv_blocks_drop(struct server *srv, struct srv_file *f)
+{
+	for (uint i = 0;  i != SRV_BLOCKS;  i++) {
+		ffmem_free(f->blocks[i].data);
+		f->blocks[i].data = NULL;
+		f->blocks[i].len = 0;
+	}
+	srv->cached -= f->cached;
+	f->cached = 0;
+}
+
+static void srv_file_free(struct server *srv, struct srv_file *f)
+{
+	srv_blocks_drop(srv, f);
+	ffmem_free(f->blocks);
+	fffile_close(f->fd);
+	ffmem_free(f->name);
+	ffmem_free(f);
+}
+
+/** Remove the file from table and free it if it's not used */
+static void srv_file_release(struct server *srv, uint i)
+{
+	struct srv_file **ff = srv->files.ptr, *f = ff[i];
+	if (f->refs != 0 || !f->stale)
+		return;
+	ffslice_rmT((ffslice*)&srv->files, i, 1, struct srv_file*);
+	srv_file_free(srv, f);
+}
+
+/** Find the least recently used file.  Lock must be held.
+idle: only the files not used by queries
+Return -1 if not found */
+static int srv_file_lru(struct server *srv, uint idle)
+{
+	struct srv_file **ff = srv->files.ptr;
+	int k = -1;
+	for (uint i = 0;  i != srv->files.len;  i++) {
+		if ((idle && ff[i]->refs != 0)
+			|| (!idle && ff[i]->cached == 0))
+			continue;
+		if (k < 0 || ff[i]->used < ff[k]->used)
+			k = i;
+	}
+	return k;
+}
+
+/** Close the least recently used files not used by queries while there are too many of them.
+Lock must be held. */
+static void srv_files_limit(struct server *srv)
+{
+	int i;
+	while (srv->files.len >= SRV_FILES_MAX
+		&& 0 <= (i = srv_file_lru(srv, 1))) {
+		struct srv_file **ff = srv->files.ptr, *f = ff[i];
+		dbglog(srv->conf, "%s: closing idle file", f->name);
+		ffslice_rmT((ffslice*)&srv->files, i, 1, struct srv_file*);
+		srv_file_free(srv, f);
+	}
+}
+
+/** Free the blocks of the least recently used files until there's space for 'n' more bytes.
+The file not used by queries is closed.
+Lock must be held.
+Return 0 if there's enough space */
+static int srv_cache_limit(struct server *srv, uint64 n)
+{
+	int i;
+	while (srv->cached + n > SRV_CACHE_MAX) {
+		if (0 > (i = srv_file_lru(srv, 0)))
+			return -1;
+		struct srv_file **ff = srv->files.ptr, *f = ff[i];
+		if (f->refs == 0) {
+			dbglog(srv->conf, "%s: closing idle file", f->name);
+			ffslice_rmT((ffslice*)&srv->files, i, 1, struct srv_file*);
+			srv_file_free(srv, f);
+		} else {
+			dbglog(srv->conf, "%s: dropping %U bytes of cached blocks", f->name, f->cached);
+			srv_blocks_drop(srv, f);
+		}
+	}
+	return 0;
+}
+
+/** Return 1 if the file path is within one of the allowed directories */
+static int srv_allowed(struct server *srv, const char *path)
+{
+	char **it;
+	FFSLICE_WALK(&srv->allow, it) {
+		ffsize n = ffsz_len(*it);
+		if (!ffmem_cmp(path, *it, n)
+			&& (path[n] == '/' || (n != 0 && (*it)[n - 1] == '/')))
+			return 1;
+	}
+	return 0;
+}
+
+/** Find the file entry by descriptor.  Lock must be held. */
+static int srv_file_find(struct server *srv, fffd fd)
+{
+	struct srv_file **ff = srv->files.ptr;
+	for (uint i = 0;  i != srv->files.len;  i++) {
+		if (ff[i]->fd == fd)
+			return i;
+	}
+	return -1;
+}
+
+static fffd srv_file_open(void *shared, const char *fn)
+{
+	struct server *srv = shared;
+	struct srv_file **ff, *f = NULL;
+	struct stat st;
+	fffd fd = FFFILE_NULL;
+	char *name;
+
+	if (NULL == (name = realpath(fn, NULL)))
+		return FFFILE_NULL;
+	if (!srv_allowed(srv, name)) {
+		dbglog(srv->conf, "%s: the file isn't within the allowed directories", name);
+		free(name);
+		errno = EACCES;
+		return FFFILE_NULL;
+	}
+	if (0 != stat(name, &st)) {
+		free(name);
+		return FFFILE_NULL;
+	}
+
+	pthread_mutex_lock(&srv->lock);
+
+	ff = srv->files.ptr;
+	for (uint i = 0;  i != srv->files.len;  i++) {
+		if (ff[i]->stale || !ffsz_eq(ff[i]->name, name))
+			continue;
+		if (ff[i]->dev == st.st_dev && ff[i]->ino == st.st_ino) {
+			f = ff[i];
+			break;
+		}
+		dbglog(srv->conf, "%s: file has changed", name);
+		ff[i]->stale = 1;
+		srv_file_release(srv, i);
+		break;
+	}
+
+	if (f == NULL) {
+		if (FFFILE_NULL == (fd = fffile_open(name, FFFILE_READONLY | FFFILE_NOATIME)))
+			goto end;
+		srv_files_limit(srv);
+		f = ffmem_new(struct srv_file);
+		f->name = ffsz_dup(name);
+		f->fd = fd;
+		f->dev = st.st_dev;
+		f->ino = st.st_ino;
+		f->blocks = ffmem_calloc(SRV_BLOCKS, sizeof(struct srv_block));
+		*ffvec_pushT(&srv->files, struct srv_file*) = f;
+		dbglog(srv->conf, "%s: opened", name);
+	}
+
+	char head[SRV_HEAD];
+	int r = fffile_readat(f->fd, head, SRV_HEAD, 0);
+	r = ffmax(r, 0);
+	uint64 size = fffile_size(f->fd);
+	if (size < f->size
+		|| (uint)r < f->head_len
+		|| ffmem_cmp(head, f->head, f->head_len)) {
+		dbglog(srv->conf, "%s: file is truncated or rewritten", name);
+		srv_blocks_drop(srv, f);
+	}
+	f->size = size;
+	ffmem_copy(f->head, head, r);
+	f->head_len = r;
+	f->used = ++srv->clock;
+	f->refs++;
+	fd = f->fd;
+
+end:
+	pthread_mutex_unlock(&srv->lock);
+	free(name);
+	return fd;
+}
+
+static void srv_file_close(void *shared, fffd fd)
+{
+	struct server *srv = shared;
+	pthread_mutex_lock(&srv->lock);
+	int i = srv_file_find(srv, fd);
+	if (i >= 0) {
+		struct srv_file **ff = srv->files.ptr;
+		ff[i]->refs--;
+		srv_file_release(srv, i);
+	}
+	pthread_mutex_unlock(&srv->lock);
+}
+
+static ffsize srv_block_get(void *shared, fffd fd, uint64 off, char *buf, ffsize len)
+{
+	struct server *srv = shared;
+	ffsize n = 0;
+	pthread_mutex_lock(&srv->lock);
+	int i = srv_file_find(srv, fd);
+	if (i >= 0) {
+		struct srv_file **ff = srv->files.ptr;
+		struct srv_block *b = &ff[i]->blocks[(off / len) % SRV_BLOCKS];
+		if (b->data != NULL && b->off == off && b->len == len) {
+			ffmem_copy(buf, b->data, len);
+			n = len;
+			ff[i]->used = ++srv->clock;
+		}
+	}
+	pthread_mutex_unlock(&srv->lock);
+	return n;
+}
+
+static void srv_block_put(void *shared, fffd fd, uint64 off, const char *data, ffsize len)
+{
+	struct server *srv = shared;
+	pthread_mutex_lock(&srv->lock);
+	int i = srv_file_find(srv, fd);
+	if (i >= 0) {
+		struct srv_file **ff = srv->files.ptr, *f = ff[i];
+		struct srv_block *b = &f->blocks[(off / len) % SRV_BLOCKS];
+		if (b->len != len) {
+			ffmem_free(b->data);
+			b->data = NULL;
+			f->cached -= b->len;
+			srv->cached -= b->len;
+			b->len = 0;
+			f->used = ++srv->clock; // the least recently used file is another one (unless it's the only one)
+			if (0 == srv_cache_limit(srv, len)
+				&& NULL != (b->data = ffmem_alloc(len))) {
+				b->len = len;
+				f->cached += len;
+				srv->cached += len;
+			}
+		}
+		if (b->data != NULL) {
+			ffmem_copy(b->data, data, len);
+			b->off = off;
+		}
+	}
+	pthread_mutex_unlock(&srv->lock);
+}
+
+static const struct arlg_shared_if srv_shared_if = {
+	srv_file_open, srv_file_close, srv_block_get, srv_block_put
+};
+
+
+/** Send all data to client
+Return 0 on success */
+static int srv_send(struct srv_query *q, const char *d, ffsize n)
+{
+	while (n != 0) {
+		ssize_t r = send(q->sk, d, n, MSG_NOSIGNAL);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		d += r;
+		n -= r;
+	}
+	return 0;
+}
+
+static int srv_output(void *udata, const char *d, ffsize n)
+{
+	return srv_send(udata, d, n);
+}
+
+static void srv_log(void *udata, uint level, const char *msg, ffsize len)
+{
+	static const char prefix[][8] = {
+		"ERR:\t",
+		"INFO:\t",
+		"DBG:\t",
+		"STATS:\t",
+	};
+	ffvec buf = {};
+	ffvec_addfmt(&buf, "%s%*s\n", prefix[level], len, msg);
+	srv_send(udata, buf.ptr, buf.len);
+	ffvec_free(&buf);
+}
+
+/** Receive the request line
+Return N of bytes (without LF);  -1 on error */
+static ffssize srv_request(struct srv_query *q, char *buf, ffsize cap)
+{
+	ffsize n = 0;
+	for (;;) {
+		ssize_t r = recv(q->sk, buf + n, cap - n, 0);
+		if (r <= 0) {
+			if (r < 0 && errno == EINTR)
+				continue;
+			return -1;
+		}
+		ffssize i = ffs_findchar(buf + n, r, '\n');
+		n += r;
+		if (i >= 0)
+			return n - r + i;
+		if (n == cap)
+			return -1;
+	}
+}
+
+static int srv_query_thread(void *param)
+{
+	struct srv_query *q = param;
+	struct server *srv = q->srv;
+	struct archeolog *a = NULL;
+	struct arlg_conf conf = {};
+	ffvec args = {}; // char*[]
+	char *req = ffmem_alloc(SRV_REQ_MAX);
+	ffssize n;
+
+	conf.log = srv_log;
+	conf.output = srv_output;
+	conf.udata = q;
+
+	if (0 > (n = srv_request(q, req, SRV_REQ_MAX - 1))) {
+		errlog(&conf, "bad request");
+		goto end;
+	}
+	req[n] = '\0';
+	dbglog(srv->conf, "query: %s", req);
+
+	// "a\tb" -> {"", "a", "b"}
+	*ffvec_pushT(&args, char*) = "";
+	for (char *p = req;  ;  ) {
+		*ffvec_pushT(&args, char*) = p;
+		if (NULL == (p = strchr(p, '\t')))
+			break;
+		*p++ = '\0';
+	}
+
+	if (0 != conf_cmdline(&conf, args.len, (const char**)args.ptr))
+		goto end;
+	// a query must not load code or create files on the server
+	if (conf.plugins.len != 0 || conf.serve != NULL || conf.trace != NULL
+		|| conf.serve_allow.len != 0 || conf.index) {
+		errlog(&conf, "--plugin, --serve, --allow, --trace and --index aren't allowed in a query");
+		goto end;
+	}
+	conf.shared_if = &srv_shared_if;
+	conf.shared = srv;
+
+	if (conf.inputs.len != 0) {
+		arlg_merge(&conf);
+		goto end;
+	}
+	if (NULL == (a = arlg_create(&conf)))
+		goto end;
+	arlg_extract(a);
+
+end:
+	arlg_free(a);
+	conf_destroy(&conf);
+	ffvec_free(&args);
+	ffmem_free(req);
+	close(q->sk);
+	ffmem_free(q);
+	__atomic_fetch_sub(&srv->queries, 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+int serve(struct arlg_conf *conf)
+{
+	int rc = 1, lsk = -1;
+	struct server srv = {};
+	srv.conf = conf;
+	pthread_mutex_init(&srv.lock, NULL);
+
+	char **it;
+	FFSLICE_WALK(&conf->serve_allow, it) {
+		char *dir;
+		if (NULL == (dir = realpath(*it, NULL))) {
+			errlog(conf, "allowed directory: %s: %E", *it, fferr_last());
+			goto end;
+		}
+		*ffvec_pushT(&srv.allow, char*) = ffsz_dup(dir);
+		free(dir);
+		dbglog(conf, "allowed directory: %s", *ffslice_lastT(&srv.allow, char*));
+	}
+
+	struct sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	if (ffsz_len(conf->serve) >= sizeof(addr.sun_path)) {
+		errlog(conf, "socket path is too long: %s", conf->serve);
+		goto end;
+	}
+	ffsz_copyz(addr.sun_path, sizeof(addr.sun_path), conf->serve);
+
+	if (0 > (lsk = socket(AF_UNIX, SOCK_STREAM, 0))) {
+		errlog(conf, "socket: %E", fferr_last());
+		goto end;
+	}
+	unlink(conf->serve); // the socket file left by the previous instance
+	// the socket file is created with the configured mode (there are no other threads yet)
+	mode_t um = umask(~conf->serve_mode & 0777);
+	int r = bind(lsk, (struct sockaddr*)&addr, sizeof(addr));
+	umask(um);
+	if (0 != r
+		|| 0 != listen(lsk, SRV_MAX_QUERIES)) {
+		errlog(conf, "socket bind: %s: %E", conf->serve, fferr_last());
+		goto end;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	infolog(conf, "listening on %s", conf->serve);
+
+	for (;;) {
+		int sk = accept(lsk, NULL, NULL);
+		if (sk < 0) {
+			if (errno == EINTR)
+				continue;
+			errlog(conf, "socket accept: %E", fferr_last());
+			break;
+		}
+
+		if (__atomic_load_n(&srv.queries, __ATOMIC_ACQUIRE) >= SRV_MAX_QUERIES) {
+			static const char busy[] = "ERR:\tserver is busy\n";
+			send(sk, busy, FFS_LEN(busy), MSG_NOSIGNAL);
+			close(sk);
+			continue;
+		}
+
+		struct srv_query *q = ffmem_new(struct srv_query);
+		q->srv = &srv;
+		q->sk = sk;
+		__atomic_fetch_add(&srv.queries, 1, __ATOMIC_RELEASE);
+		ffthread th;
+		if (FFTHREAD_NULL == (th = ffthread_create(srv_query_thread, q, 0))) {
+			errlog(conf, "thread create: %E", fferr_last());
+			__atomic_fetch_sub(&srv.queries, 1, __ATOMIC_RELEASE);
+			close(sk);
+			ffmem_free(q);
+			continue;
+		}
+		ffthread_detach(th);
+	}
+
+end:
+	if (lsk >= 0) {
+		close(lsk);
+		unlink(conf->serve);
+	}
+	FFSLICE_WALK(&srv.allow, it) {
+		ffmem_free(*it);
+	}
+	ffvec_free(&srv.allow);
+	pthread_mutex_destroy(&srv.lock);
+	return rc;
+}
+
+#else
+
+int serve(struct arlg_conf *conf)
+{
+	errlog(conf, "--serve isn't supported on this OS");
+	return 1;
+}
+
+#endif
@@ -1,24 +1,186 @@
 /** archeolog: find start date
 2022, Simon Zolin */
 
+/*
+Binary search: jump to the middle of the window, check the first line after the jump offset
+ and continue within the half where the start-date line is.
+The window is [start_off..jump_end);  end_off is the earliest line known to be at or after start-date.
+When no lines start between the jump offset and jump_end (long lines),
+ the window shrinks to the jump offset.
+When the window is small, the lines are checked sequentially from start_off.
+
+If the block at the middle isn't in page cache, the jump goes to the nearest cached block
+ within the middle half of the window: the window still gets at least 1/4 smaller,
+ and a read from memory is much faster than from disk.
+
+The window ends at the end of data: the zero bytes and holes at the end of file aren't searched.
+With the relative dates the window ends at the line with the newest timestamp,
+ which the file filter has found by reading backward from the end of data.
+With --index the window is narrowed to the block where the first line at or after start-date is
+ according to the zone map (the min/max timestamps of each block).
+In a sparse file a jump into a hole continues at the next data region,
+ where a line starts after the zero bytes padding the region.
+
+Jump block size (probe) is adapted:
+ . it grows when the first timestamp after the jump isn't within the block;
+ . it's large enough for the average distance to the next line;
+ . on a device with long access time a larger block costs the same as a small one,
+   and the window gets small enough for the sequential search sooner.
+*/
+
+#define SD_PROBE_MAX  (1*1024*1024)
+#define SD_PROBE_RATE  64 // bytes per usec of read latency
+#define SD_RESIDENT_TRIES  16 // N of blocks to check on each side of the middle of the window
+#define SD_RESIDENT_MIN  (1*1024*1024) // min. window size to check page cache
+
+/** Set block size for the next jump */
+static void startdate_probe_tune(struct archeolog *a)
+{
+	struct arlg_startdate *sd = &a->startdate;
+	const struct arlg_file *f = &a->file;
+	uint64 n = sd->probe_min;
+	if (sd->ngaps != 0)
+		n = ffmax(n, 2 * sd->gap_sum / sd->ngaps + a->conf->date_len);
+	if (!a->conf->probe_fixed && f->rand_reads != 0)
+		n = ffmax(n, f->rand_read_usec / f->rand_reads * SD_PROBE_RATE);
+	n = ffint_align_power2(n);
+	n = ffmin(n, SD_PROBE_MAX);
+	n = ffmin(n, a->conf->read_chunk_size_large);
+	n = ffmax(n, a->conf->read_chunk_size_small);
+	if (n != sd->probe) {
+		dbglog(a->conf, "startdate: probe size: %U", n);
+		sd->probe = n;
+	}
+	arlg_file_probe(a, sd->probe);
+}
+
+/** Find the offset of the cached block nearest to 'mid' within [lo..hi)
+Return 'mid' if there's no such block */
+static uint64 startdate_cached_pivot(struct archeolog *a, uint64 mid, uint64 lo, uint64 hi)
+{
+	struct arlg_startdate *sd = &a->startdate;
+	uint page = a->file.page_size;
+	ffbyte vec[SD_PROBE_MAX / 4096];
+	if (page == 0)
+		return mid;
+	uint np = ffint_align_ceil2(sd->probe, page) / page;
+	if (np > sizeof(vec))
+		return mid;
+
+	// check the blocks to the left and to the right of the middle, the nearest first;
+	//  the blocks are spread evenly over [lo..hi)
+	uint64 align = ffmax(page, a->conf->read_chunk_align);
+	uint64 step = ffmax(sd->probe, (hi - lo) / 2 / SD_RESIDENT_TRIES);
+	step = ffint_align_ceil2(step, align);
+	uint64 m = ffint_align_floor2(mid, align);
+	for (uint d = 0;  d <= SD_RESIDENT_TRIES;  d++) {
+		for (int side = 0;  side != 2;  side++) {
+			if (d == 0 && side == 1)
+				break;
+			uint64 off = (side == 0) ? m - d * step : m + d * step;
+			if ((side == 0 && d * step > m)
+				|| off < lo || off >= hi)
+				continue;
+			if (0 != file_resident(a, off, np * page, vec))
+				return mid;
+			uint k;
+			for (k = 0;  k != np;  k++) {
+				if (!(vec[k] & 1))
+					break;
+			}
+			if (k == np) {
+				if (d != 0)
+					sd->ncached++;
+				return (d != 0) ? off : mid;
+			}
+		}
+	}
+	return mid;
+}
+
+/** The zero bytes are followed by a hole: continue after the hole
+Return 0: no hole;  1: seek;  -1: no data until the window end */
+static int startdate_hole_skip(struct archeolog *a)
+{
+	struct arlg_startdate *sd = &a->startdate;
+	if (!a->file.sparse)
+		return 0;
+	int64 d = fffile_data_next(a->file.fd, a->off);
+	if (d == (int64)a->off)
+		return 0;
+
+	uint64 end = (sd->seq_scan) ? sd->end_off : sd->jump_end;
+	if (d < 0 || (uint64)d > end
+		|| ((uint64)d == end && !(sd->seq_scan && sd->end_found)))
+		return -1;
+
+	dbglog(a->conf, "startdate: skipping hole @%U..%U", a->off, d);
+	a->off = d;
+	if (!sd->seq_scan)
+		sd->jump_off = d; // the hole isn't a part of the distance to the next line
+	arlg_file_seek(a, d);
+	return 1;
+}
+
 int startdate_open(struct archeolog *a)
 {
 	struct arlg_startdate *sd = &a->startdate;
-	if (a->conf->start_date.sec == 0) {
+	if (a->conf->start_date.sec == 0
+		&& !(a->conf->explain && a->conf->end_date.sec != 0)) {
 		return CHAIN_DONE;
 	}
 	arlg_file_behaviour(a, FBEH_RANDOM);
-	sd->end_off = a->file.size;
+	sd->end_off = a->file.data_end;
+	if (a->conf->dates_rel
+		&& fftime_cmp(&a->file.newest, &a->conf->start_date) >= 0) {
+		// the line with the newest timestamp is at or after start-date
+		sd->end_off = a->file.newest_off;
+		sd->end_found = 1;
+	}
+	sd->jump_end = sd->end_off;
+	index_window(a, &sd->start_off, &sd->jump_end);
 	sd->off_prev = (uint64)-1;
-	if (a->conf->debug)
+	sd->probe_min = a->conf->read_chunk_size_small;
+	if (a->conf->debug || a->conf->stats)
 		sd->time_start = fftime_monotonic();
+	sd->reads_start = a->stats.reads;
+	sd->eof_ok = (a->conf->hist_interval != 0 || a->conf->sample != 0 || a->conf->explain
+		|| a->conf->merged);
 	ffstream_realloc(&sd->stm, a->conf->date_len);
 	return CHAIN_READY;
 }
 
+/** Search again for the new start-date.
+off: the data before this offset is known to be before start-date */
+void startdate_restart(struct archeolog *a, uint64 off)
+{
+	struct arlg_startdate *sd = &a->startdate;
+	arlg_file_behaviour(a, FBEH_RANDOM);
+	sd->state = 0;
+	sd->start_off = off;
+	sd->end_off = a->file.data_end;
+	sd->jump_end = sd->end_off;
+	index_window(a, &sd->start_off, &sd->jump_end);
+	sd->off_prev = (uint64)-1;
+	sd->njumps = 0;
+	sd->ncached = 0;
+	sd->dcache.len = 0;
+	sd->seq_scan = 0;
+	sd->end_found = 0;
+	sd->skip_line = 0;
+	sd->skip_zeros = 0;
+	sd->eof = 0;
+	ffstr_null(&sd->input);
+	ffstream_reset(&sd->stm);
+	if (a->conf->debug || a->conf->stats)
+		sd->time_start = fftime_monotonic();
+	sd->reads_start = a->stats.reads;
+}
+
 void startdate_close(struct archeolog *a)
 {
 	struct arlg_startdate *sd = &a->startdate;
+	dbglog(a->conf, "startdate: copied %U bytes", sd->stm.copied);
 	ffstream_free(&sd->stm);
 }
 
@@ -36,19 +198,30 @@ int startdate_find(struct archeolog *a, ffstr *in, ffstr *out)
 	for (;;) {
 		switch (sd->state) {
 		case I_FIRST:
+			if (a->conf->start_date.sec == 0) {
+				// --explain without start-date: only the end-date is searched
+				line_off = 0;
+				ffstr_null(&view);
+				goto done;
+			}
 			goto seek;
 
 		case I_GATHER:
 			r = ffstream_gather_ref(&sd->stm, *in, a->conf->date_len, &buf);
 			ffstr_shift(in, r);
 			a->off += r;
+			sd->eof = 0;
 			if (buf.len < a->conf->date_len) {
 				if (sd->stm.ref.len != 0)
 					continue; // store input data in buffer
-				if (a->file.read_last && in->len == 0) {
-					goto fin;
+				if (!(a->file.read_last && in->len == 0)) {
+					if (!sd->seq_scan)
+						sd->jump_reads++;
+					return CHAIN_PREV;
 				}
-				return CHAIN_PREV;
+				if (buf.len == 0)
+					goto fin;
+				sd->eof = 1; // check the last lines with the data we have
 			}
 			view = buf;
 			sd->state = a->nxstate;
@@ -56,8 +229,38 @@ int startdate_find(struct archeolog *a, ffstr *in, ffstr *out)
 
 		case I_FINDLINE:
 			line_off = a->off - view.len;
-			if (line_off != 0) {
-				if (0 > (r = newline_find(&view))) {
+			if (sd->skip_zeros) {
+				for (r = 0;  (ffsize)r != view.len && view.ptr[r] == '\0';  r++) {}
+				ffstr_shift(&view, r);
+				ffstream_consume(&sd->stm, r);
+				if (view.len == 0) {
+					ffstream_reset(&sd->stm);
+					r = startdate_hole_skip(a);
+					if (r < 0)
+						goto fin;
+					sd->state = I_GATHER,  a->nxstate = I_FINDLINE;
+					if (r > 0)
+						return CHAIN_PREV;
+					continue;
+				}
+				sd->skip_zeros = 0;
+				sd->skip_line = 0;
+				line_off = a->off - view.len;
+
+			} else if (line_off != 0 || sd->skip_line) {
+				sd->skip_line = 0;
+				r = newline_find(&view);
+				if (a->file.sparse) {
+					// the data region ends before the line end
+					ffssize z = ffs_findchar(view.ptr, (r >= 0) ? (ffsize)r : view.len, '\0');
+					if (z >= 0) {
+						ffstr_shift(&view, z);
+						ffstream_consume(&sd->stm, z);
+						sd->skip_zeros = 1;
+						continue;
+					}
+				}
+				if (r < 0) {
 					ffstream_reset(&sd->stm);
 					sd->state = I_GATHER,  a->nxstate = I_FINDLINE;
 					continue;
@@ -66,41 +269,56 @@ int startdate_find(struct archeolog *a, ffstr *in, ffstr *out)
 				ffstream_consume(&sd->stm, r);
 				line_off = a->off - view.len;
 			}
-			if (line_off >= sd->end_off)
+			if (sd->seq_scan) {
+				// check the line at end_off too: the next filters need its timestamp
+				if (line_off >= sd->end_off && !sd->end_found)
+					goto fin;
+			} else if (line_off >= sd->jump_end) {
 				goto fin;
+			}
 			sd->state = I_CHECK;
 			// fallthrough
 
 		case I_CHECK: {
-			fftime curdate;
-			r = date_parse(a->conf, &view, &curdate);
-			if (r < 0) {
+			int cmp;
+			r = date_cmp(a->conf, &view, DATE_START, (sd->seq_scan) ? &sd->dcache : NULL, &cmp);
+			if (r < 0 && !sd->eof) {
 				// not enough data
 				sd->state = I_GATHER,  a->nxstate = I_CHECK;
 				continue;
-			} else if (r == 0) {
-				// invalid timestamp
-				ffstream_consume(&sd->stm, a->conf->date_len);
+			} else if (r <= 0) {
+				// invalid timestamp: skip this line
+				sd->skip_line = 1;
 				sd->state = I_GATHER,  a->nxstate = I_FINDLINE;
 				continue;
 			}
 
 			line_off = a->off - view.len;
-			dbglog("check: %*s @%U[%U..%U](%U)"
+			dbglog(a->conf, "check: %*s @%U[%U..%U](%U)"
 				, (ffsize)r, view.ptr, line_off
-				, sd->start_off, sd->end_off, sd->end_off - sd->start_off);
+				, sd->start_off, sd->jump_end, sd->jump_end - sd->start_off);
 
-			if (fftime_cmp(&curdate, &a->conf->start_date) < 0) {
+			if (!sd->seq_scan) {
+				sd->gap_sum += line_off - sd->jump_off;
+				sd->ngaps++;
+				if (sd->jump_reads != 0) {
+					// the timestamp wasn't within the block
+					sd->probe_min = ffmin(ffint_align_power2(line_off + r - sd->jump_off), SD_PROBE_MAX);
+					sd->jump_reads = 0;
+				}
+			}
+
+			if (cmp < 0) {
 				sd->start_off = line_off + 1;
-				sd->start_date = curdate;
 				if (sd->seq_scan) {
-					ffstream_consume(&sd->stm, a->conf->date_len);
+					ffstream_consume(&sd->stm, r);
 					sd->state = I_GATHER,  a->nxstate = I_FINDLINE;
 					continue;
 				}
 			} else {
 				sd->end_off = line_off;
-				sd->end_date = curdate;
+				sd->jump_end = line_off;
+				sd->end_found = 1;
 				if (sd->seq_scan)
 					goto done;
 			}
@@ -116,35 +334,75 @@ int startdate_find(struct archeolog *a, ffstr *in, ffstr *out)
 	}
 
 seek:
-	if (sd->end_off - sd->start_off <= a->conf->read_chunk_size_small * 2) {
+	startdate_probe_tune(a);
+	if (sd->jump_end - sd->start_off <= sd->probe * 2) {
 		sd->seq_scan = 1; // small window: start sequential search
 		a->off = sd->start_off;
 	} else {
-		off = (sd->end_off - sd->start_off) / 2 - a->conf->read_chunk_size_small;
+		uint64 w = sd->jump_end - sd->start_off;
+		off = w / 2 - sd->probe;
 		a->off = sd->start_off + ffmax(off, 0);
-	}
+		if (w >= SD_RESIDENT_MIN)
+			a->off = startdate_cached_pivot(a, a->off, sd->start_off + w / 4, sd->start_off + w / 4 * 3);
+		// the whole block after the jump offset is read
+		uint64 aligned = ffint_align_floor2(a->off, a->conf->read_chunk_align);
+		if (aligned > sd->start_off)
+			a->off = aligned;
 
-	if (a->off == sd->off_prev) {
-		goto err;
+		if (a->off == sd->off_prev) {
+			// the window doesn't get smaller
+			sd->seq_scan = 1;
+			a->off = sd->start_off;
+		}
 	}
+	sd->skip_zeros = 0;
+	if (a->file.sparse) {
+		// don't read the hole
+		int64 d = fffile_data_next(a->file.fd, a->off);
+		if (!sd->seq_scan && (d < 0 || (uint64)d >= sd->jump_end)) {
+			// no data between the jump offset and the window end
+			sd->jump_end = a->off;
+			goto seek;
+		}
+		if (d > (int64)a->off) {
+			a->off = d;
+			sd->skip_zeros = 1;
+		}
+	}
+	// sequential search may start at the offset of the last jump
 	sd->off_prev = a->off;
+	sd->jump_off = a->off;
+	sd->jump_reads = 0;
 
 	ffstream_reset(&sd->stm);
 	sd->state = I_GATHER,  a->nxstate = I_FINDLINE;
 	arlg_file_seek(a, a->off);
 	sd->njumps++;
+	a->stats.jumps++;
 	return CHAIN_PREV;
 
 fin:
-	if (sd->end_date.sec == 0)
-		goto err;
+	if (!sd->seq_scan) {
+		// no lines start between the jump offset and the window end
+		sd->jump_end = sd->jump_off;
+		goto seek;
+	}
+	if (!sd->end_found) {
+		if (!sd->eof_ok)
+			goto err;
+		// there are no lines at or after start-date
+		line_off = sd->end_off;
+		ffstr_null(&view);
+	}
 
 done:
-	if (a->conf->debug) {
+	if (a->conf->debug || a->conf->stats) {
 		fftime t = fftime_monotonic();
 		fftime_sub(&t, &sd->time_start);
-		dbglog("found start-time line @%U in %uus, %u jumps"
-			, a->off, fftime_usec(&t), sd->njumps);
+		a->stats.search_usec += fftime_usec(&t);
+		a->stats.search_reads += a->stats.reads - sd->reads_start;
+		dbglog(a->conf, "found start-time line @%U in %uus, %u jumps (%u to cached pages)"
+			, a->off, fftime_usec(&t), sd->njumps, sd->ncached);
 	}
 	ffstream_reset(&sd->stm);
 	sd->state = I_DONE;
@@ -154,7 +412,7 @@ done:
 	return CHAIN_NEXT;
 
 err:
-	errlog("can't find start-time line");
+	errlog(a->conf, "can't find start-time line");
 	return CHAIN_ERR;
 }
 
@@ -0,0 +1,105 @@
+/** archeolog: timeline trace (--trace)
+2022, Simon Zolin */
+
+/*
+The events are collected in memory and written to file after the processing,
+ in Chrome trace-event format (open in chrome://tracing or ui.perfetto.dev):
+
+{"traceEvents":[
+{"name":"file", "cat":"filter", "ph":"X", "ts":12.345, "dur":6.789, "pid":1, "tid":1, "args":{"in":0, "out":65536, "ret":"CHAIN_NEXT"}},
+{"name":"read", "cat":"io", "ph":"X", "ts":12.400, "dur":6.500, "pid":1, "tid":1, "args":{"bytes":65536}},
+...
+]}
+
+Categories:
+ "open" - filter's open();
+ "filter" - filter's process();
+ "io" - file read syscall or waiting for the reader thread;
+ "output" - write syscall or passing the data to the writer thread.
+An event of a nested call (e.g. file read by 'file' filter) lies within its parent event.
+Time is in microseconds since the first call of arlg_extract().
+*/
+
+#define TRACE_MAX_EVENTS  (1*1024*1024)
+
+static uint64 trace_nsec(fftime t, fftime since)
+{
+	fftime_sub(&t, &since);
+	return (uint64)t.sec * 1000000000 + t.nsec;
+}
+
+/** Add the event which has started at 'start' and ends now
+ret: filter's return code (NULL for I/O events: 'in' is N of bytes) */
+static void trace_add(struct archeolog *a, const char *name, const char *cat, fftime start
+	, uint64 in, uint64 out, const char *ret)
+{
+	struct arlg_trace *tr = &a->trace;
+	fftime end = fftime_monotonic();
+	struct trace_event *e;
+	if (tr->events.len == TRACE_MAX_EVENTS
+		|| NULL == (e = ffvec_pushT(&tr->events, struct trace_event))) {
+		tr->dropped++;
+		return;
+	}
+	e->name = name;
+	e->cat = cat;
+	e->start = trace_nsec(start, tr->start);
+	e->dur = trace_nsec(end, start);
+	e->in = in;
+	e->out = out;
+	e->ret = ret;
+}
+
+/** Add "usec.nnn" */
+static void trace_usec(ffvec *buf, uint64 nsec)
+{
+	uint ns = nsec % 1000;
+	char frac[4] = { '.', '0' + ns / 100, '0' + ns / 10 % 10, '0' + ns % 10 };
+	ffvec_addfmt(buf, "%U", nsec / 1000);
+	ffvec_add(buf, frac, 4, 1);
+}
+
+/** Write the events to file */
+static void trace_write(struct archeolog *a)
+{
+	struct arlg_trace *tr = &a->trace;
+	ffvec buf = {};
+	fffd f = FFFILE_NULL;
+
+	ffvec_addsz(&buf, "{\"traceEvents\":[\n{\"name\":\"thread_name\", \"ph\":\"M\", \"pid\":1, \"tid\":1, \"args\":{\"name\":\"");
+	json_escape_add(&buf, a->conf->filename);
+	ffvec_addsz(&buf, "\"}}");
+
+	const struct trace_event *e;
+	FFSLICE_WALK(&tr->events, e) {
+		ffvec_addfmt(&buf, ",\n{\"name\":\"%s\", \"cat\":\"%s\", \"ph\":\"X\", \"ts\":"
+			, e->name, e->cat);
+		trace_usec(&buf, e->start);
+		ffvec_addsz(&buf, ", \"dur\":");
+		trace_usec(&buf, e->dur);
+		if (e->ret != NULL)
+			ffvec_addfmt(&buf, ", \"pid\":1, \"tid\":1, \"args\":{\"in\":%U, \"out\":%U, \"ret\":\"%s\"}}"
+				, e->in, e->out, e->ret);
+		else
+			ffvec_addfmt(&buf, ", \"pid\":1, \"tid\":1, \"args\":{\"bytes\":%U}}"
+				, e->in);
+	}
+	ffvec_addsz(&buf, "\n]}\n");
+
+	if (FFFILE_NULL == (f = fffile_open(a->conf->trace, FFFILE_CREATE | FFFILE_TRUNCATE | FFFILE_WRITEONLY))) {
+		errlog(a->conf, "trace: file open: %s: %E", a->conf->trace, fferr_last());
+		goto end;
+	}
+	if ((ffssize)buf.len != fffile_write(f, buf.ptr, buf.len)) {
+		errlog(a->conf, "trace: file write: %s: %E", a->conf->trace, fferr_last());
+		goto end;
+	}
+	dbglog(a->conf, "trace: %L events written to %s", tr->events.len, a->conf->trace);
+	if (tr->dropped != 0)
+		infolog(a->conf, "trace: too many events: %u aren't written", tr->dropped);
+
+end:
+	if (f != FFFILE_NULL)
+		fffile_close(f);
+	ffvec_free(&buf);
+}
@@ -0,0 +1,134 @@
+/** ff: arena allocator: the memory is released at once
+2022, Simon Zolin
+*/
+
+/*
+ffarena_init ffarena_free
+ffarena_alloc
+*/
+
+#pragma once
+#include <ffbase/base.h>
+#ifdef FF_UNIX
+#include <sys/mman.h>
+#endif
+
+enum FFARENA_F {
+	/* Back the memory by 2MB pages:
+	 explicit huge pages (MAP_HUGETLB) if the system has them reserved,
+	 otherwise ask for transparent huge pages */
+	FFARENA_HUGEPAGES = 1,
+};
+
+#define FFARENA_PAGE  4096
+#define FFARENA_HUGEPAGE  (2*1024*1024)
+
+struct ffarena_chunk {
+	struct ffarena_chunk *next;
+	char *ptr;
+	ffsize cap, len;
+};
+
+typedef struct ffarena {
+	struct ffarena_chunk *chunks; // the current chunk is the first
+	ffsize chunk_size; // minimum chunk size
+	ffuint flags; // enum FFARENA_F
+	ffuint64 total; // N of bytes mapped
+	ffuint nchunks, huge_chunks; // N of chunks;  N of chunks backed by MAP_HUGETLB
+} ffarena;
+
+static inline void ffarena_init(ffarena *a, ffsize chunk_size, ffuint flags)
+{
+	ffmem_zero_obj(a);
+	a->chunk_size = chunk_size;
+	a->flags = flags;
+}
+
+/** Map the memory for a new chunk
+size: [in] minimum size;  [out] actual size */
+static inline char* _ffarena_map(ffarena *a, ffsize *size)
+{
+#ifdef FF_UNIX
+	void *p;
+	if (a->flags & FFARENA_HUGEPAGES) {
+		*size = ffint_align_ceil2(*size, FFARENA_HUGEPAGE);
+#ifdef MAP_HUGETLB
+		p = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (p != MAP_FAILED) {
+			a->huge_chunks++;
+			return (char*)p;
+		}
+#endif
+	} else {
+		*size = ffint_align_ceil2(*size, FFARENA_PAGE);
+	}
+
+	p = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+#ifdef MADV_HUGEPAGE
+	if (a->flags & FFARENA_HUGEPAGES)
+		madvise(p, *size, MADV_HUGEPAGE); // fails if THP is disabled: the memory is still usable
+#endif
+	return (char*)p;
+
+#else
+	*size = ffint_align_ceil2(*size, FFARENA_PAGE);
+	return (char*)ffmem_align(*size, FFARENA_PAGE);
+#endif
+}
+
+static inline void _ffarena_unmap(char *p, ffsize size)
+{
+#ifdef FF_UNIX
+	munmap(p, size);
+#else
+	(void)size;
+	ffmem_alignfree(p);
+#endif
+}
+
+/** Allocate memory
+align: power of 2
+Return NULL on error */
+static inline void* ffarena_alloc(ffarena *a, ffsize size, ffsize align)
+{
+	struct ffarena_chunk *c = a->chunks;
+	if (c != NULL) {
+		ffsize off = ffint_align_ceil2((ffsize)c->ptr + c->len, align) - (ffsize)c->ptr;
+		if (off + size <= c->cap) {
+			c->len = off + size;
+			return c->ptr + off;
+		}
+	}
+
+	// the chunk start is page-aligned
+	ffsize cap = ffmax(size + ((align > FFARENA_PAGE) ? align : 0), a->chunk_size);
+	if (NULL == (c = ffmem_new(struct ffarena_chunk)))
+		return NULL;
+	if (NULL == (c->ptr = _ffarena_map(a, &cap))) {
+		ffmem_free(c);
+		return NULL;
+	}
+	c->cap = cap;
+	c->next = a->chunks;
+	a->chunks = c;
+	a->total += cap;
+	a->nchunks++;
+
+	ffsize off = ffint_align_ceil2((ffsize)c->ptr, align) - (ffsize)c->ptr;
+	c->len = off + size;
+	return c->ptr + off;
+}
+
+/** Release all memory */
+static inline void ffarena_free(ffarena *a)
+{
+	struct ffarena_chunk *c, *next;
+	for (c = a->chunks;  c != NULL;  c = next) {
+		next = c->next;
+		_ffarena_unmap(c->ptr, c->cap);
+		ffmem_free(c);
+	}
+	a->chunks = NULL;
+}
@@ -168,7 +168,8 @@ static inline int ffcmdarg_parse(ffcmdarg *p, ffstr *dst)
 
 		ffstr_setz(&s, p->argv[p->iarg]);
 
-		if (s.ptr[0] == '-') {
+		if (s.ptr[0] == '-'
+			&& !(s.ptr[1] >= '0' && s.ptr[1] <= '9')) { // "-1" is a value
 
 			if (s.ptr[1] == '-') {
 				ffssize pos = ffstr_splitby(&s, '=', &s, &p->longval);
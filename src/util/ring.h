@@ -0,0 +1,72 @@
+/** ff: lock-free single-producer single-consumer ring buffer of pointers
+2022, Simon Zolin
+*/
+
+/*
+ffspsc_alloc ffspsc_free
+ffspsc_reset
+ffspsc_push
+ffspsc_pop
+*/
+
+#pragma once
+#include <ffbase/base.h>
+
+/* One thread pushes, another thread pops.
+The producer writes 'w' and only reads 'r', the consumer writes 'r' and only reads 'w'. */
+typedef struct ffspsc {
+	void **ptr;
+	ffuint mask;
+	ffuint w; // producer position
+	char pad[64 - sizeof(ffuint)];
+	ffuint r; // consumer position
+} ffspsc;
+
+/** Allocate buffer
+cap: capacity, power of 2
+Return 0 on success */
+static inline int ffspsc_alloc(ffspsc *q, ffuint cap)
+{
+	FF_ASSERT(cap != 0 && (cap & (cap - 1)) == 0);
+	if (NULL == (q->ptr = (void**)ffmem_calloc(cap, sizeof(void*))))
+		return -1;
+	q->mask = cap - 1;
+	q->w = q->r = 0;
+	return 0;
+}
+
+static inline void ffspsc_free(ffspsc *q)
+{
+	ffmem_free(q->ptr);
+	q->ptr = NULL;
+}
+
+/** Remove all items.  Neither thread must be using the ring. */
+static inline void ffspsc_reset(ffspsc *q)
+{
+	q->w = q->r = 0;
+}
+
+/** Add an item (producer)
+Return 0: the ring is full */
+static inline int ffspsc_push(ffspsc *q, void *p)
+{
+	ffuint w = q->w;
+	if (w - __atomic_load_n(&q->r, __ATOMIC_ACQUIRE) == q->mask + 1)
+		return 0;
+	q->ptr[w & q->mask] = p;
+	__atomic_store_n(&q->w, w + 1, __ATOMIC_RELEASE); // publish the item
+	return 1;
+}
+
+/** Get an item (consumer)
+Return 0: the ring is empty */
+static inline int ffspsc_pop(ffspsc *q, void **p)
+{
+	ffuint r = q->r;
+	if (r == __atomic_load_n(&q->w, __ATOMIC_ACQUIRE))
+		return 0;
+	*p = q->ptr[r & q->mask];
+	__atomic_store_n(&q->r, r + 1, __ATOMIC_RELEASE); // the slot may be reused
+	return 1;
+}
@@ -0,0 +1,91 @@
+/** ff: SIMD-accelerated search in string
+2022, Simon Zolin
+*/
+
+/*
+ffsimd_findany2
+ffsimd_findnl_range
+ffsimd_count
+*/
+
+#pragma once
+#include <ffbase/string.h>
+#ifdef __SSE2__
+	#include <emmintrin.h>
+#endif
+
+/** Find the first occurrence of any of the 2 characters
+Return index;  -1 if not found */
+static inline ffssize ffsimd_findany2(const char *p, ffsize n, int c1, int c2)
+{
+	ffsize i = 0;
+
+#ifdef __SSE2__
+	const __m128i v1 = _mm_set1_epi8((char)c1), v2 = _mm_set1_epi8((char)c2);
+	for (;  i + 16 <= n;  i += 16) {
+		__m128i d = _mm_loadu_si128((__m128i*)(p + i));
+		ffuint m = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(d, v1), _mm_cmpeq_epi8(d, v2)));
+		if (m != 0)
+			return i + __builtin_ctz(m);
+	}
+#endif
+
+	for (;  i < n;  i++) {
+		if (p[i] == c1 || p[i] == c2)
+			return i;
+	}
+	return -1;
+}
+
+/** Find a new line that is followed by a character within the range [lo..hi]
+Return index of '\n';  -1 if not found */
+static inline ffssize ffsimd_findnl_range(const char *p, ffsize n, ffbyte lo, ffbyte hi)
+{
+	ffsize i = 0;
+
+#ifdef __SSE2__
+	const __m128i nl = _mm_set1_epi8('\n'), vlo = _mm_set1_epi8((char)lo), vrange = _mm_set1_epi8((char)(hi - lo));
+	for (;  i + 17 <= n;  i += 16) {
+		__m128i d = _mm_loadu_si128((__m128i*)(p + i));
+		__m128i next = _mm_sub_epi8(_mm_loadu_si128((__m128i*)(p + i + 1)), vlo);
+		// (next - lo) <= (hi - lo) as unsigned
+		__m128i in_range = _mm_cmpeq_epi8(_mm_min_epu8(next, vrange), next);
+		ffuint m = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(d, nl), in_range));
+		if (m != 0)
+			return i + __builtin_ctz(m);
+	}
+#endif
+
+	for (;  i + 1 < n;  i++) {
+		if (p[i] == '\n' && (ffbyte)(p[i + 1] - lo) <= (ffbyte)(hi - lo))
+			return i;
+	}
+	return -1;
+}
+
+/** Count the occurrences of a character */
+static inline ffsize ffsimd_count(const char *p, ffsize n, int c)
+{
+	ffsize i = 0, k = 0;
+
+#ifdef __SSE2__
+	const __m128i v = _mm_set1_epi8((char)c), zero = _mm_setzero_si128();
+	while (i + 16 <= n) {
+		// 8-bit counters can hold up to 255 matches
+		__m128i acc = zero;
+		ffsize end = i + ffmin(n - i, 255 * 16);
+		for (;  i + 16 <= end;  i += 16) {
+			__m128i d = _mm_loadu_si128((__m128i*)(p + i));
+			acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(d, v));
+		}
+		acc = _mm_sad_epu8(acc, zero);
+		k += _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+	}
+#endif
+
+	for (;  i < n;  i++) {
+		if (p[i] == c)
+			k++;
+	}
+	return k;
+}
@@ -0,0 +1,68 @@
+/** ff: sparse files: data regions and holes;  zero blocks
+2022, Simon Zolin
+*/
+
+/*
+fffile_data_next fffile_hole_next
+ffmem_zeroed
+ffstr_trim_zeros
+*/
+
+#pragma once
+#include <ffbase/string.h>
+#include <FFOS/file.h>
+
+/** Find the data at or after 'off'
+Return offset;
+ -1: there's no data after 'off';
+ 'off': holes aren't supported by OS or file system */
+static inline ffint64 fffile_data_next(fffd fd, ffuint64 off)
+{
+#if defined FF_UNIX && defined SEEK_DATA
+	off_t r = lseek(fd, off, SEEK_DATA);
+	if (r < 0)
+		return (errno == ENXIO) ? -1 : (ffint64)off;
+	return r;
+#else
+	(void)fd;
+	return off;
+#endif
+}
+
+/** Find the hole at or after 'off' (there's always a hole at the end of file)
+Return offset;  -1: holes aren't supported */
+static inline ffint64 fffile_hole_next(fffd fd, ffuint64 off)
+{
+#if defined FF_UNIX && defined SEEK_HOLE
+	off_t r = lseek(fd, off, SEEK_HOLE);
+	if (r < 0)
+		return -1;
+	return r;
+#else
+	(void)fd;  (void)off;
+	return -1;
+#endif
+}
+
+/** Return 1 if all bytes are zero */
+static inline int ffmem_zeroed(const void *d, ffsize n)
+{
+	const char *p = (char*)d;
+	// compare the data with itself shifted by 1 byte: memcmp() is vectorized
+	return (n == 0
+		|| (p[0] == '\0' && !ffmem_cmp(p, p + 1, n - 1)));
+}
+
+/** Skip zero bytes at both ends of data
+ (a data region of sparse file is padded by zeros to the file system block size) */
+static inline void ffstr_trim_zeros(ffstr *s)
+{
+	while (s->len != 0 && s->ptr[s->len - 1] == '\0') {
+		s->len--;
+	}
+	ffsize i = 0;
+	while (i != s->len && s->ptr[i] == '\0') {
+		i++;
+	}
+	ffstr_shift(s, i);
+}
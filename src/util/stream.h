@@ -19,6 +19,9 @@ typedef struct ffstream {
 	ffuint r, w;
 	ffuint cap, mask;
 	ffstr ref;
+	ffuint header; // N of bytes at the end of our buffer which directly precede the next input data
+	const char *header_next; // the next input data (the rest of input after the header bytes)
+	ffuint64 copied; // N of bytes copied into the buffer
 } ffstream;
 
 /** Grow the buffer
@@ -59,6 +62,7 @@ static inline void ffstream_free(ffstream *s)
 static inline void ffstream_reset(ffstream *s)
 {
 	s->r = s->w = 0;
+	s->header = 0;
 }
 
 /** Get N of valid bytes */
@@ -106,6 +110,7 @@ static inline ffuint ffstream_gather(ffstream *s, ffstr input, ffsize gather, ff
 		// append input data to tail
 		n = ffmin(n, input.len);
 		ffmem_copy(s->ptr + i, input.ptr, n);
+		s->copied += n;
 		s->w += n;
 
 		used = s->w - s->r;
@@ -118,25 +123,32 @@ static inline ffuint ffstream_gather(ffstream *s, ffstr input, ffsize gather, ff
 
 /** Gather a contiguous region of at least `gather` bytes of data with minimum data copying.
 Reference (don't copy) input data when possible to minimize data copying.
-However, the use-case of data searching with partial consuming becomes very slow
- because there will always be some data left in the buffer,
- which means that referencing the data becomes impossible,
- thus defeating the purpose of this function.
- TODO Implement _avpack_gather_header/_trailer()-like algorithm?
-input: input data, must stay valid while 'output' is used
+When there's not enough data left in the referenced buffer,
+ only these bytes (trailer) and the minimum N of the next input bytes (header) are copied.
+As soon as the trailer bytes are consumed,
+ the input data is referenced again (the header bytes are still there in the input).
+input: input data, must stay valid while 'output' is used;
+ if it isn't consumed completely, the next call must pass the rest of it (shifted by the returned value):
+ the header bytes are referenced at their place in input memory;
+ a new input may be passed only after the previous one is consumed completely
 output: buffer view or input data view, valid until the next call to this function
 Return N of input bytes referenced or consumed */
 static inline ffuint ffstream_gather_ref(ffstream *s, ffstr input, ffsize gather, ffstr *output)
 {
 	FF_ASSERT(gather <= s->cap);
+	FF_ASSERT(s->header == 0 || input.len == 0 || input.ptr == s->header_next);
 	ffuint i, n = 0, used = s->w - s->r;
 
 	if (used < gather) {
-		if (used == 0) {
-			// reference and return the whole input buffer
-			s->ref = input;
+		if (used == 0
+			|| (used <= s->header && input.len != 0 && input.ptr == s->header_next)) {
+			// reference the whole input buffer
+			//  along with the header bytes in our buffer that precede it
+			s->ref.ptr = input.ptr - used;
+			s->ref.len = used + input.len;
 			s->w += input.len;
-			*output = input;
+			s->header = 0;
+			ffstr_set(output, s->ref.ptr, s->ref.len);
 			return input.len;
 		}
 
@@ -145,14 +157,11 @@ static inline ffuint ffstream_gather_ref(ffstream *s, ffstr input, ffsize gather
 		if (s->ref.len != 0) {
 			// copy used data from the referenced buffer into our buffer
 			ffmem_copy(s->ptr, s->ref.ptr + s->ref.len - used, used);
+			s->copied += used;
 			s->ref.len = 0;
 			s->r = 0;
 			s->w = used;
 
-			// going to append minimum input data to tail until we have `gather` bytes available
-			n = gather - used;
-			i = s->w;
-
 		} else {
 			i = s->r & s->mask;
 			if (i + gather > s->cap) {
@@ -161,17 +170,17 @@ static inline ffuint ffstream_gather_ref(ffstream *s, ffstr input, ffsize gather
 				s->r -= i;
 				s->w -= i;
 			}
-
-			// going to append input data to tail as much as we can fit
-			i = s->w & s->mask;
-			ffuint unused_seq = s->cap - i; // "...DDU"
-			n = unused_seq;
 		}
 
-		// append input data to tail
-		n = ffmin(n, input.len);
+		// append minimum input data to tail until we have `gather` bytes available
+		i = s->w & s->mask;
+		n = ffmin(gather - used, input.len);
 		ffmem_copy(s->ptr + i, input.ptr, n);
+		s->copied += n;
 		s->w += n;
+		// the header bytes are followed by the rest of input data
+		s->header = (n != input.len) ? s->header + n : 0;
+		s->header_next = input.ptr + n;
 
 		used = s->w - s->r;
 
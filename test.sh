@@ -26,3 +26,102 @@ fi
 ./archeolog LOG -s '18:48:12.685' -e '18:48:12.685'
 ./archeolog LOG -s '18:48:12.685' -e '18:48:12.686'
 ./archeolog LOG -s '18:48:12.685' -e '18:48:12.687'
+
+# timestamp formats
+if ! test -f LOG_SYSLOG ; then
+	echo 'Jun 26 18:48:12 host prog[1]: line1
+Jun 26 18:48:13 host prog[1]: line2
+Jun 26 18:48:14 host prog[1]: line3
+Jun 26 18:48:15 host prog[1]: line4' >LOG_SYSLOG
+fi
+./archeolog LOG_SYSLOG -s 'Jun 26 18:48:13' -e 'Jun 26 18:48:14'
+./archeolog LOG_SYSLOG -s '2022-06-26 18:48:14'
+
+if ! test -f LOG_NGINX ; then
+	echo '127.0.0.1 - - [26/Jun/2022:18:48:12 +0000] "GET /1 HTTP/1.1" 200 1
+127.0.0.1 - - [26/Jun/2022:18:48:13 +0000] "GET /2 HTTP/1.1" 200 1
+127.0.0.1 - - [26/Jun/2022:18:48:14 +0000] "GET /3 HTTP/1.1" 200 1' >LOG_NGINX
+fi
+./archeolog LOG_NGINX -s '2022-06-26 18:48:13'
+./archeolog LOG_NGINX -s '2022-06-26 18:48:13' -e '2022-06-26 18:48:13' --ts-field=4
+
+if ! test -f LOG_EPOCH ; then
+	echo '101 1656269292.685 line1
+102 1656269293.685 line2
+103 1656269294.686 line3' >LOG_EPOCH
+fi
+./archeolog LOG_EPOCH -s '1656269293'
+./archeolog LOG_EPOCH -s '2022-06-26T18:48:13Z' --ts-offset=4
+
+if ! test -f LOG_JSON ; then
+	echo '{"level":"info","ts":"2022-06-26T18:48:12.685Z","msg":"line1"}
+{"msg":"line2","ts":"2022-06-26T18:48:13.685Z"}
+{"level":"info","ts":"2022-06-26T18:48:14.686Z","msg":"line3"}' >LOG_JSON
+fi
+./archeolog LOG_JSON -s '2022-06-26 18:48:13' -e '2022-06-26 18:48:13'
+./archeolog LOG_JSON -s '2022-06-26 18:48:14' --json=ts
+
+if ! test -f LOG_TRACE ; then
+	echo '2022-06-26 18:48:12 INFO line1
+2022-06-26 18:48:13 ERROR line2
+java.lang.Exception: line2
+	at Main.main(Main.java:1)
+2022-06-26 18:48:14 INFO line3
+	at Main.main(Main.java:2)' >LOG_TRACE
+fi
+./archeolog LOG_TRACE --filter=Main.java
+./archeolog LOG_TRACE --filter=ERROR --records
+./archeolog LOG_TRACE -s '2022-06-26 18:48:13' -e '2022-06-26 18:48:13' --filter=Main --records
+./archeolog LOG_TRACE -s -1s
+./archeolog LOG_TRACE -s 'Jun 26 18:48:13' -e '2022-06-26 18:48:13'
+./archeolog LOG_TRACE -s '18:48:13' -e 'Jun 26 18:48:13'
+./archeolog LOG_TRACE --start=-2s -e -1s --records
+
+./archeolog LOG_TRACE -s '2022-06-26 18:48:12' -e '2022-06-26 18:48:14' --histogram=1s
+./archeolog LOG_TRACE -s '2022-06-26 18:48:12' -e '2022-06-26 18:48:14' --histogram=1s --exact
+./archeolog LOG_TRACE -s '2022-06-26 18:48:13' -e '2022-06-26 18:48:14' --sample=10%
+./archeolog LOG_TRACE -s '2022-06-26 18:48:13' -e '2022-06-26 18:48:13' --explain
+./archeolog LOG_TRACE -e '2022-06-26 18:48:13' --explain --interp
+./archeolog LOG_TRACE --fields=2,4-
+./archeolog LOG_TRACE -s '2022-06-26 18:48:13' -e '2022-06-26 18:48:13' --stats=json
+./archeolog LOG_TRACE -s '2022-06-26 18:48:13' --trace=LOG_TRACE.trace.json
+./archeolog LOG_TRACE -s '2022-06-26 18:48:13' -e '2022-06-26 18:48:13' --probe=1024 --align=512
+./archeolog LOG_NGINX --fields=4,6-7 --delim=' '
+./archeolog LOG_TRACE --columns=12-19,21-
+./archeolog LOG_TRACE -l 1
+
+./archeolog LOG_TRACE -s '2022-06-26 18:48:13' --chain=file,startdate,data,out
+./archeolog LOG_TRACE --chain=file,match,out --filter=line2
+./archeolog LOG_TRACE --chain=file,project,match,out --fields=2,4- --filter=line2
+if test -f redact.so ; then
+	./archeolog LOG_TRACE --plugin=./redact.so
+	./archeolog LOG_TRACE --plugin=./redact.so --chain=file,redact,match,out --filter='(Main.java:#)'
+	./archeolog LOG_TRACE --plugin=./redact.so --chain=file,project,redact,out --fields=2,4-
+fi
+
+./archeolog LOG_TRACE -s '2022-06-26 18:48:13' --threads
+./archeolog LOG_TRACE --filter=Main --records --threads
+./archeolog LOG_TRACE --filter=Main --records --threads --hugepages
+
+# preallocated space (zero bytes) and a hole at the end of file
+if ! test -f LOG_ZERO ; then
+	cp LOG_TRACE LOG_ZERO
+	head -c 10000 /dev/zero >>LOG_ZERO
+	truncate -s 1M LOG_ZERO
+fi
+./archeolog LOG_ZERO -s '2022-06-26 18:48:13'
+./archeolog LOG_ZERO --threads
+./archeolog LOG_ZERO -s -1s
+
+./archeolog LOG_TRACE LOG_JSON
+./archeolog LOG_TRACE LOG_JSON -s '2022-06-26 18:48:13' -e '2022-06-26 18:48:13'
+./archeolog LOG_TRACE LOG_EPOCH -s -1s
+
+# content index: 2 blocks
+if ! test -f LOG_INDEX ; then
+	awk 'BEGIN { for (i = 0;  i != 50000;  i++) printf "2022-06-26 00:00:%02u.%03u id=%u lorem ipsum\n", i / 1000, i % 1000, i }' >LOG_INDEX
+fi
+rm -f LOG_INDEX.arlgidx
+./archeolog LOG_INDEX --index --filter='id=49999' --word
+./archeolog LOG_INDEX --index --filter=' id=1234 ' -s '2022-06-26 00:00:01'
+test "$(./archeolog LOG_INDEX --index --filter=id=777 --word)" = "$(./archeolog LOG_INDEX --filter=id=777 --word)"